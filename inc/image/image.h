@@ -19,27 +19,57 @@
 
 #include <vector>
 #include <stdexcept>
+#include <functional>
 #include <cinttypes>
 
+#include "image/imageallocator.h"
+#include "image/imagepixelformat.h"
+
 namespace image
 {
 
 enum class ResizeAlgorithm
 {
     NearestNeighbor,
-    Bilinear
+    Bilinear,
+    Bicubic,
+    Mitchell,
+    Lanczos3,
+    Area        // averages the covered source pixels, falls back to bilinear when enlarging
 };
 
-class Image
+// Runs the provided task asynchronously (e.g. on a thread pool)
+using Executor = std::function<void(std::function<void()> task)>;
+
+struct ResizeOptions
 {
-    struct Pixel
-    {
-        uint8_t r;
-        uint8_t g;
-        uint8_t b;
-        uint8_t a;
-    };
+    // Number of horizontal bands of the destination that are resized concurrently
+    // 0 uses the number of hardware threads
+    uint32_t    threads = 1;
+
+    // Executor used to process the bands, when not set a thread is spawned for every band
+    Executor    executor;
+
+    // Blend 8-bit samples in linear light instead of blending the sRGB encoded values, which
+    // darkens reduced images. The alpha channel of images with 2 or 4 color planes is not converted.
+    bool        linearLight = false;
+
+    // Premultiply the colors by the alpha channel before filtering and divide them again afterwards,
+    // prevents the color of fully transparent pixels from bleeding into their neighbours.
+    // Only used for images with 2 or 4 color planes, the last plane is the alpha channel.
+    bool        premultiplyAlpha = false;
+};
 
+// Alignment of the rows of the images created by the loaders and by resizing: every row is padded
+// to start at a multiple of the alignment (e.g. PixelAlignment) so the kernels can use full vector
+// loads. The default of 1 keeps the rows tightly packed.
+void setRowAlignment(uint32_t alignment);
+uint32_t rowAlignment();
+
+class ImageView;
+
+class Image
+{
 public:
     Image() = default;
     Image(Image&&) = default;
@@ -48,102 +78,128 @@ public:
     Image& operator=(Image&&) = default;
     Image& operator=(const Image&) = delete;
 
-    void resize(uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo)
-    {
-        if (data.empty())
-        {
-            throw std::runtime_error("Failed to resize image, no data present");
-        }
-        
-        if (bitDepth != 8)
-        {
-            throw std::runtime_error("Resizing is only supported for images with a bitdepth of 8");
-        }
-
-        std::vector<uint8_t> resizedData(newWidth * newHeight * colorPlanes);
-
-        if (algo == ResizeAlgorithm::NearestNeighbor)
-        {
-            double scaleWidth   = static_cast<double>(newWidth) / static_cast<double>(width);
-            double scaleHeight  = static_cast<double>(newHeight) / static_cast<double>(height);
-        
-            if (colorPlanes == 3)
-            {
-                for (uint32_t y = 0; y < newHeight; ++y)
-                {
-                    for (uint32_t x = 0; x < newWidth; ++x)
-                    {
-                        int pixel = (y * (newWidth * 3)) + (x * 3);
-                        int nearestMatch = (((int)(y / scaleHeight) * (width * 3)) + ((int)(x / scaleWidth) * 3));
-                        
-                        resizedData[pixel    ] =  data[nearestMatch    ];
-                        resizedData[pixel + 1] =  data[nearestMatch + 1];
-                        resizedData[pixel + 2] =  data[nearestMatch + 2];
-                    }
-                }
-            }
-        }
-        else
-        {
-            if (colorPlanes == 3)
-            {
-                const uint32_t planes = colorPlanes;
-                const uint32_t stride = (width * planes);
-            
-                for (uint32_t y = 0; y < newHeight; ++y)
-                {
-                    const float gy = (float(y) / newHeight) * height - 0.5f;
-                    const float fy = gy - uint32_t(gy);
-                    const float fy1 = 1.0f - fy;
-                    const uint32_t gyi = uint32_t(gy) * stride;
-                    
-                    for (uint32_t x = 0; x < newWidth; ++x)
-                    {
-                        const float gx = (float(x) / newWidth) * width - 0.5f;
-                        const float fx = gx - uint32_t(gx);
-                        const float fx1 = 1.0f - fx;
-                        const uint32_t gxi = uint32_t(gx) * planes;
-                        
-                        const Pixel* p1 = reinterpret_cast<Pixel*>(&data[gyi + gxi]);
-                        const Pixel* p2 = reinterpret_cast<Pixel*>(&data[gyi + gxi + planes]);
-                        const Pixel* p3 = reinterpret_cast<Pixel*>(&data[(gyi + stride) + gxi]);
-                        const Pixel* p4 = reinterpret_cast<Pixel*>(&data[(gyi + stride) + gxi + planes]);
-                        
-                        // Calculate the weights for each pixel
-                        const uint32_t w1 = fx1 * fy1 * 256.0f;
-                        const uint32_t w2 = fx  * fy1 * 256.0f;
-                        const uint32_t w3 = fx1 * fy  * 256.0f;
-                        const uint32_t w4 = fx  * fy  * 256.0f;
-
-                        // Calculate the weighted sum of pixels (for each color channel)
-                        Pixel* result = reinterpret_cast<Pixel*>(&resizedData[(y * newWidth * planes) + (x * planes)]);
-                        result->r = (p1->r * w1 + p2->r * w2 + p3->r * w3 + p4->r * w4) >> 8;
-                        result->g = (p1->g * w1 + p2->g * w2 + p3->g * w3 + p4->g * w4) >> 8;
-                        result->b = (p1->b * w1 + p2->b * w2 + p3->b * w3 + p4->b * w4) >> 8;
-                        if (planes == 4)
-                        {
-                            result->a = (p1->a * w1 + p2->a * w2 + p3->a * w3 + p4->a * w4) >> 8;
-                        }
-                    }
-                }
-            }
-
-        }
-        
-        data    = resizedData;
-        width   = newWidth;
-        height  = newHeight;
-    }
+    // Deep copy of the image, copying is explicit because the pixel data can be large
+    Image clone() const;
+
+    void resize(uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo);
+    void resize(uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options);
 
+    // Resize into another image, the data buffer of the destination is reused when it is large enough
+    void resizeInto(Image& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo) const;
+    void resizeInto(Image& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options) const;
+
+    // Resize into caller owned memory, the start of the destination rows are stride bytes apart
+    void resizeInto(uint8_t* dst, uint32_t stride, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo) const;
+    void resizeInto(uint8_t* dst, uint32_t stride, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options) const;
+
+    // Sets the dimensions and allocates uninitialized data, the rows are padded to rowAlignment()
+    void allocate(uint32_t width, uint32_t height, uint32_t colorPlanes, uint32_t bitDepth);
+    void allocate(uint32_t width, uint32_t height, PixelFormat format);
+
+    // The format of the colorPlanes and bitDepth members, throws when they are not supported
+    PixelFormat format() const;
+
+    // Bytes between the start of two rows
+    uint32_t rowStride() const;
+
+    uint8_t* row(uint32_t y);
+    const uint8_t* row(uint32_t y) const;
+
+    // A row of typed pixels, throws when the image has a different format
+    template <PixelFormat Format>
+    Pixel<Format>* pixels(uint32_t y);
+    template <PixelFormat Format>
+    const Pixel<Format>* pixels(uint32_t y) const;
+
+    // A view on a region of the image, no pixels are copied
+    ImageView crop(uint32_t x, uint32_t y, uint32_t cropWidth, uint32_t cropHeight) const;
 
     uint32_t                width = 0;
     uint32_t                height = 0;
     uint32_t                bitDepth = 0;
     uint32_t                colorPlanes = 0;
-    
-    std::vector<uint8_t>    data;
+
+    // Bytes between the start of two rows, 0 when the rows are tightly packed
+    uint32_t                stride = 0;
+
+    // interleaved samples, 16-bit samples are stored in native byte order
+    // resizing the data does not initialize the new samples
+    PixelData               data;
 };
 
+// Non-owning description of pixel memory: a complete image, a region of an image or externally
+// owned memory (e.g. a framebuffer). The memory has to stay valid while the view is used.
+class ImageView
+{
+public:
+    ImageView() = default;
+    ImageView(const uint8_t* data, uint32_t width, uint32_t height, uint32_t stride, uint32_t colorPlanes, uint32_t bitDepth);
+    ImageView(const uint8_t* data, uint32_t width, uint32_t height, uint32_t stride, PixelFormat format);
+
+    // Views the complete image, throws when the image data is smaller than its dimensions
+    ImageView(const Image& image);
+
+    // A view on a region of this view, throws when the region is not inside the view
+    ImageView crop(uint32_t x, uint32_t y, uint32_t cropWidth, uint32_t cropHeight) const;
+
+    PixelFormat format() const;
+
+    const uint8_t* row(uint32_t y) const;
+
+    template <PixelFormat Format>
+    const Pixel<Format>* pixels(uint32_t y) const;
+
+    // Resize the viewed pixels, identical to the resize methods of Image
+    void resizeInto(Image& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo) const;
+    void resizeInto(Image& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options) const;
+    void resizeInto(uint8_t* dst, uint32_t stride, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo) const;
+    void resizeInto(uint8_t* dst, uint32_t stride, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options) const;
+
+    const uint8_t*          data = nullptr;
+    uint32_t                width = 0;
+    uint32_t                height = 0;
+    uint32_t                bitDepth = 0;
+    uint32_t                colorPlanes = 0;
+
+    // Bytes between the start of two rows
+    uint32_t                stride = 0;
+};
+
+void throwPixelFormatMismatch(PixelFormat expected, PixelFormat actual);
+
+template <PixelFormat Format>
+Pixel<Format>* Image::pixels(uint32_t y)
+{
+    if (format() != Format)
+    {
+        throwPixelFormatMismatch(Format, format());
+    }
+
+    return reinterpret_cast<Pixel<Format>*>(row(y));
+}
+
+template <PixelFormat Format>
+const Pixel<Format>* Image::pixels(uint32_t y) const
+{
+    if (format() != Format)
+    {
+        throwPixelFormatMismatch(Format, format());
+    }
+
+    return reinterpret_cast<const Pixel<Format>*>(row(y));
+}
+
+template <PixelFormat Format>
+const Pixel<Format>* ImageView::pixels(uint32_t y) const
+{
+    if (format() != Format)
+    {
+        throwPixelFormatMismatch(Format, format());
+    }
+
+    return reinterpret_cast<const Pixel<Format>*>(row(y));
+}
+
 }
 
 #endif
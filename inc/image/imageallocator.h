@@ -0,0 +1,155 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#ifndef IMAGE_ALLOCATOR_H
+#define IMAGE_ALLOCATOR_H
+
+#include <new>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include <cinttypes>
+#include <type_traits>
+
+namespace image
+{
+
+// Alignment of the pixel data of images, a multiple of the widest SIMD register and the cache line size
+constexpr size_t PixelAlignment = 64;
+
+// Functions providing the memory for pixel data, allocate returns memory aligned to at least
+// the requested alignment or throws std::bad_alloc
+using PixelAllocateFunction = void* (*)(size_t size, size_t alignment);
+using PixelDeallocateFunction = void (*)(void* memory, size_t size, size_t alignment);
+
+// Replaces the functions used to allocate pixel data, passing nullptr restores the default
+// aligned allocator. Memory is released with the functions that are active at that time, so the
+// functions should be installed before any image is created.
+void setPixelAllocator(PixelAllocateFunction allocate, PixelDeallocateFunction deallocate);
+
+// Back pixel buffers of 2MB or more with transparent huge pages to reduce the TLB misses when
+// processing large images. Only applies to the default allocator on Linux, disabled by default.
+void setPixelHugePages(bool enabled);
+
+// Store the pixel buffers of minimumSize bytes or more in memory mapped files created in the
+// directory instead of in anonymous memory, the kernel can then write the pixels back to the disk
+// and drop them from memory when memory gets tight. The files are deleted immediately and
+// disappear when the buffers are released. Use a directory on a disk, a tmpfs directory does not
+// reduce the memory usage. An empty directory disables the file backing (default).
+// Only applies to the default allocator, throws on platforms without memory mapped files.
+void setPixelFileBacking(const std::string& directory, size_t minimumSize = 256 * 1024 * 1024);
+
+struct PixelPoolStatistics
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t retainedBytes = 0;
+};
+
+// Keep released pixel buffers of 64KB or more for reuse by the next image of a similar size
+// instead of returning them to the system, at most maxRetainedBytes are kept. While the pool is
+// enabled, buffers of 64KB or more are rounded up to buckets that are at most 25% apart. Only those
+// buffers are retained, buffers allocated while the pool was disabled are released with their
+// exact size. A capacity of 0 disables the pool (default) and releases the retained buffers.
+void setPixelPoolCapacity(size_t maxRetainedBytes);
+
+// Releases the retained buffers, the pool stays enabled
+void clearPixelPool();
+
+PixelPoolStatistics pixelPoolStatistics();
+
+void* allocatePixels(size_t size);
+void deallocatePixels(void* memory, size_t size) noexcept;
+
+// Allocator for pixel data: the memory is aligned to PixelAlignment and growing a buffer leaves
+// the new samples uninitialized, decoders overwrite them anyway
+template <typename T>
+class PixelAllocator
+{
+public:
+    using value_type = T;
+
+    PixelAllocator() = default;
+
+    template <typename U>
+    PixelAllocator(const PixelAllocator<U>&) noexcept
+    {
+    }
+
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(allocatePixels(count * sizeof(T)));
+    }
+
+    void deallocate(T* memory, size_t count) noexcept
+    {
+        deallocatePixels(memory, count * sizeof(T));
+    }
+
+    template <typename U>
+    void construct(U* value) noexcept(std::is_nothrow_default_constructible<U>::value)
+    {
+        ::new (static_cast<void*>(value)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* value, Args&&... args)
+    {
+        ::new (static_cast<void*>(value)) U(std::forward<Args>(args)...);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PixelAllocator<T>&, const PixelAllocator<U>&)
+{
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PixelAllocator<T>&, const PixelAllocator<U>&)
+{
+    return false;
+}
+
+using PixelData = std::vector<uint8_t, PixelAllocator<uint8_t>>;
+
+// Compare pixel data with regular byte vectors
+inline bool operator==(const PixelData& lhs, const std::vector<uint8_t>& rhs)
+{
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+inline bool operator==(const std::vector<uint8_t>& lhs, const PixelData& rhs)
+{
+    return rhs == lhs;
+}
+
+inline bool operator!=(const PixelData& lhs, const std::vector<uint8_t>& rhs)
+{
+    return !(lhs == rhs);
+}
+
+inline bool operator!=(const std::vector<uint8_t>& lhs, const PixelData& rhs)
+{
+    return !(rhs == lhs);
+}
+
+}
+
+#endif
@@ -32,6 +32,7 @@ enum class Type
 
 class Image;
 class ILoadStore;
+struct DecodeOptions;
 
 class Factory
 {
@@ -45,6 +46,15 @@ public:
     static std::unique_ptr<Image> createFromData(const uint8_t* pData, uint64_t dataSize);
     static std::unique_ptr<Image> createFromData(const std::vector<uint8_t>& data, Type imageType);
     static std::unique_ptr<Image> createFromData(const uint8_t* pData, uint64_t dataSize, Type imageType);
+
+    // Decodes at a reduced size when the image type supports it, see DecodeOptions
+    static std::unique_ptr<Image> createFromUri(const std::string& uri, const DecodeOptions& options);
+    static std::unique_ptr<Image> createFromUri(const std::string& uri, Type imageType, const DecodeOptions& options);
+
+    static std::unique_ptr<Image> createFromData(const std::vector<uint8_t>& data, const DecodeOptions& options);
+    static std::unique_ptr<Image> createFromData(const uint8_t* pData, uint64_t dataSize, const DecodeOptions& options);
+    static std::unique_ptr<Image> createFromData(const std::vector<uint8_t>& data, Type imageType, const DecodeOptions& options);
+    static std::unique_ptr<Image> createFromData(const uint8_t* pData, uint64_t dataSize, Type imageType, const DecodeOptions& options);
 };
 
 }
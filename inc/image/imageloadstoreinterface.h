@@ -17,6 +17,9 @@
 #ifndef IMAGE_LOAD_STORE_INTERFACE_H
 #define IMAGE_LOAD_STORE_INTERFACE_H
 
+#include <algorithm>
+#include <functional>
+
 #include "image/image.h"
 
 namespace utils
@@ -27,6 +30,19 @@ namespace utils
 namespace image
 {
 
+struct DecodeOptions
+{
+    // Decode at 1/scaleDenominator of the size (1, 2, 4 or 8) when the format can do this cheaper
+    // than a full decode (jpeg scales during the inverse DCT), the dimensions are rounded up.
+    // Other formats are decoded at full size.
+    uint32_t    scaleDenominator = 1;
+
+    // When set, the largest reduction that still decodes to at least this size is used instead
+    // of the scaleDenominator, e.g. the size of the thumbnail the image is resized to afterwards
+    uint32_t    minimumWidth = 0;
+    uint32_t    minimumHeight = 0;
+};
+
 class ILoadStore
 {
 public:
@@ -39,11 +55,34 @@ public:
     virtual std::unique_ptr<Image> loadFromReader(utils::IReader& reader) = 0;
     virtual std::unique_ptr<Image> loadFromMemory(const uint8_t* pData, uint64_t dataSize) = 0;
     virtual std::unique_ptr<Image> loadFromMemory(const std::vector<uint8_t>& data) = 0;
+    virtual std::unique_ptr<Image> loadFromMemory(const uint8_t* pData, uint64_t dataSize, const DecodeOptions& options) = 0;
+
+    // The image can be a view on a region of an image, the region is encoded without copying it
+    virtual void storeToFile(const ImageView& image, const std::string& path) = 0;
+    virtual std::vector<uint8_t> storeToMemory(const ImageView& image) = 0;
 
-    virtual void storeToFile(const Image& image, const std::string& path) = 0;
-    virtual std::vector<uint8_t> storeToMemory(const Image& image) = 0;
+    // Encodes an image of which the rows are requested in increasing order, for images that are not
+    // completely in memory (e.g. tiled images). The row stays valid until the next row is requested.
+    // The default implementation copies the rows into an image and stores that.
+    using RowFunction = std::function<const uint8_t*(uint32_t y)>;
+    virtual std::vector<uint8_t> storeRowsToMemory(PixelFormat format, uint32_t width, uint32_t height, const RowFunction& row);
 };
 
+inline std::vector<uint8_t> ILoadStore::storeRowsToMemory(PixelFormat format, uint32_t width, uint32_t height, const RowFunction& row)
+{
+    Image image;
+    image.allocate(width, height, format);
+
+    const size_t rowBytes = size_t(width) * pixelSizeOf(format);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* pixels = row(y);
+        std::copy(pixels, pixels + rowBytes, image.row(y));
+    }
+
+    return storeToMemory(image);
+}
+
 }
 
 #endif
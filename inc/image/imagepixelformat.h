@@ -0,0 +1,141 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#ifndef IMAGE_PIXEL_FORMAT_H
+#define IMAGE_PIXEL_FORMAT_H
+
+#include <cinttypes>
+
+namespace image
+{
+
+// Interleaved sample layouts, 16-bit samples are stored in native byte order
+enum class PixelFormat
+{
+    Gray8,
+    GrayA8,
+    RGB8,
+    RGBA8,
+    Gray16,
+    GrayA16,
+    RGB16,
+    RGBA16
+};
+
+// The format of pixels with the provided number of color planes and bit depth,
+// throws when the combination is not supported
+PixelFormat pixelFormat(uint32_t colorPlanes, uint32_t bitDepth);
+
+uint32_t colorPlanesOf(PixelFormat format);
+uint32_t bitDepthOf(PixelFormat format);
+uint32_t pixelSizeOf(PixelFormat format);
+
+// The alpha channel is always the last plane
+bool hasAlpha(PixelFormat format);
+
+// Memory layout of a single pixel of a format, used to access image rows as typed pixels
+// and to select the processing kernels at compile time
+template <PixelFormat Format>
+struct Pixel;
+
+template <>
+struct Pixel<PixelFormat::Gray8>
+{
+    using Sample = uint8_t;
+    static constexpr uint32_t channels = 1;
+
+    uint8_t gray;
+};
+
+template <>
+struct Pixel<PixelFormat::GrayA8>
+{
+    using Sample = uint8_t;
+    static constexpr uint32_t channels = 2;
+
+    uint8_t gray;
+    uint8_t alpha;
+};
+
+template <>
+struct Pixel<PixelFormat::RGB8>
+{
+    using Sample = uint8_t;
+    static constexpr uint32_t channels = 3;
+
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+};
+
+template <>
+struct Pixel<PixelFormat::RGBA8>
+{
+    using Sample = uint8_t;
+    static constexpr uint32_t channels = 4;
+
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+    uint8_t alpha;
+};
+
+template <>
+struct Pixel<PixelFormat::Gray16>
+{
+    using Sample = uint16_t;
+    static constexpr uint32_t channels = 1;
+
+    uint16_t gray;
+};
+
+template <>
+struct Pixel<PixelFormat::GrayA16>
+{
+    using Sample = uint16_t;
+    static constexpr uint32_t channels = 2;
+
+    uint16_t gray;
+    uint16_t alpha;
+};
+
+template <>
+struct Pixel<PixelFormat::RGB16>
+{
+    using Sample = uint16_t;
+    static constexpr uint32_t channels = 3;
+
+    uint16_t red;
+    uint16_t green;
+    uint16_t blue;
+};
+
+template <>
+struct Pixel<PixelFormat::RGBA16>
+{
+    using Sample = uint16_t;
+    static constexpr uint32_t channels = 4;
+
+    uint16_t red;
+    uint16_t green;
+    uint16_t blue;
+    uint16_t alpha;
+};
+
+}
+
+#endif
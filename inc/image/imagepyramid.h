@@ -0,0 +1,69 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#ifndef IMAGE_PYRAMID_H
+#define IMAGE_PYRAMID_H
+
+#include <vector>
+#include <cinttypes>
+
+#include "image/image.h"
+
+namespace image
+{
+
+// Successive reductions of an image to half its size, every level is the average of the 2x2 blocks
+// of the previous level. Odd dimensions are rounded up, the last column or row of a level with an
+// odd size is averaged with itself. All levels are stored in a single allocation.
+class ImagePyramid
+{
+public:
+    // Generates the levels (1/2, 1/4, ...) of the image in one pass over the source, the reduction
+    // stops before a level would get a width or height smaller than minimumSize
+    explicit ImagePyramid(const Image& src, uint32_t minimumSize = 1);
+
+    uint32_t levels() const;
+    uint32_t width(uint32_t level) const;
+    uint32_t height(uint32_t level) const;
+    uint32_t colorPlanes() const;
+    uint32_t bitDepth() const;
+
+    // The samples of the level, rows are stored without padding
+    const uint8_t* data(uint32_t level) const;
+
+    // Copies the level into a standalone image
+    Image image(uint32_t level) const;
+
+private:
+    struct Level
+    {
+        uint32_t    width;
+        uint32_t    height;
+        size_t      offset;
+    };
+
+    const Level& level(uint32_t index) const;
+
+    uint32_t                planes;
+    uint32_t                depth;
+    std::vector<Level>      levelInfo;
+    PixelData               buffer;
+};
+
+}
+
+#endif
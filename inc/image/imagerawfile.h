@@ -0,0 +1,71 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#ifndef IMAGE_RAW_FILE_H
+#define IMAGE_RAW_FILE_H
+
+#include <string>
+#include <cinttypes>
+
+#include "image/image.h"
+
+namespace image
+{
+
+// Decoded pixels stored as is, to avoid decoding the same image again (e.g. a cache of covers).
+// The file is a 4096 byte header (dimensions, format, stride and a checksum of the pixels)
+// followed by the rows, aligned to PixelAlignment. The samples are stored in native byte order,
+// files are only meant to be read on the machine that wrote them.
+// Loading maps the file, the pixels are only read when they are used.
+class RawImageFile
+{
+public:
+    RawImageFile() = default;
+    RawImageFile(RawImageFile&& other);
+    RawImageFile(const RawImageFile&) = delete;
+    ~RawImageFile();
+
+    RawImageFile& operator=(RawImageFile&& other);
+    RawImageFile& operator=(const RawImageFile&) = delete;
+
+    // The file is written to a uniquely named file next to the path and renamed, a reader never sees
+    // a partial file and concurrent writers of the same path do not interfere. On POSIX systems the
+    // file is only accessible by its owner, like any file created with mkstemp.
+    static void storeToFile(const ImageView& image, const std::string& path);
+
+    // Maps the file read-only, throws when the header is invalid or the file is too small.
+    // The checksum is not verified because that reads all the pixels.
+    static RawImageFile loadFromFile(const std::string& path);
+
+    // Reads all the pixels and compares them with the checksum in the header
+    bool verify() const;
+
+    PixelFormat format() const;
+
+    // The pixels, valid as long as this object exists
+    ImageView view() const;
+
+private:
+    void release();
+
+    uint8_t*    mapping = nullptr;
+    size_t      size = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef IMAGE_RESIZE_PLAN_H
+#define IMAGE_RESIZE_PLAN_H
+
+#include <memory>
+#include <utility>
+#include <cinttypes>
+
+#include "image/image.h"
+
+namespace image
+{
+
+namespace resize
+{
+class Plan;
+}
+
+// Precalculated coordinate and weight tables to resize images of the same dimensions and
+// pixel format. The plan is immutable, a single plan can be used by multiple threads.
+// Whether the plan blends in linear light or with premultiplied alpha is decided on construction,
+// the linearLight and premultiplyAlpha members of the options passed to run are not used.
+class ResizePlan
+{
+public:
+    ResizePlan(uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight, ResizeAlgorithm algo, uint32_t colorPlanes, uint32_t bitDepth = 8, bool linearLight = false, bool premultiplyAlpha = false);
+
+    uint32_t sourceWidth() const;
+    uint32_t sourceHeight() const;
+    uint32_t targetWidth() const;
+    uint32_t targetHeight() const;
+    ResizeAlgorithm algorithm() const;
+    uint32_t colorPlanes() const;
+    uint32_t bitDepth() const;
+    bool linearLight() const;
+    bool premultipliedAlpha() const;
+
+    // The source image or view must match the dimensions and pixel format of the plan,
+    // the data buffer of the destination is reused when it is large enough
+    void run(const ImageView& src, Image& dst) const;
+    void run(const ImageView& src, Image& dst, const ResizeOptions& options) const;
+
+    // Resize into caller owned memory, the start of the destination rows are stride bytes apart
+    void run(const ImageView& src, uint8_t* dst, uint32_t stride) const;
+    void run(const ImageView& src, uint8_t* dst, uint32_t stride, const ResizeOptions& options) const;
+
+    // Resizing part of the image, for sources that are not completely in memory (e.g. tiled images).
+    // sourceRows and sourceColumns return the source rows or columns [first, last) that are read to
+    // produce the destination rows or columns [begin, end). runRegion produces the destination pixels
+    // of width x height at x, y from a view that only holds the source pixels starting at firstColumn,
+    // firstRow, the view needs 16 bytes of padding after its last row. dst points to the destination
+    // pixel at x, y. The pixels are identical to the result of resizing the complete image.
+    std::pair<uint32_t, uint32_t> sourceRows(uint32_t begin, uint32_t end) const;
+    std::pair<uint32_t, uint32_t> sourceColumns(uint32_t begin, uint32_t end) const;
+    void runRegion(const ImageView& srcRegion, uint32_t firstColumn, uint32_t firstRow, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint8_t* dst, uint32_t stride, const ResizeOptions& options) const;
+
+private:
+    uint32_t                            srcWidth;
+    uint32_t                            srcHeight;
+    uint32_t                            dstWidth;
+    uint32_t                            dstHeight;
+    ResizeAlgorithm                     algo;
+    uint32_t                            planes;
+    uint32_t                            depth;
+    bool                                linear;
+    bool                                premultiplied;
+    std::shared_ptr<const resize::Plan> plan;
+};
+
+}
+
+#endif
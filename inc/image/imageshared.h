@@ -0,0 +1,97 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#ifndef IMAGE_SHARED_H
+#define IMAGE_SHARED_H
+
+#include <memory>
+
+#include "image/image.h"
+
+namespace image
+{
+
+// Image shared by all its copies: copying only increments a reference count, the pixels are
+// released together with the last copy. The shared image is never modified, mutableImage() first
+// copies the pixels when other copies still reference them (copy-on-write).
+// Different copies can be used from different threads, a single SharedImage object can not.
+class SharedImage
+{
+    struct Shared;
+
+public:
+    // Modification access to an image that is not shared. Copies of the SharedImage made while the
+    // writer exists get their own copy of the pixels, so later modifications are not visible to them.
+    // The writer must not outlive the SharedImage it was obtained from.
+    class Writer
+    {
+    public:
+        Writer(Writer&& other);
+        Writer(const Writer&) = delete;
+        ~Writer();
+
+        Writer& operator=(Writer&&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        Image& operator*() const;
+        Image* operator->() const;
+
+    private:
+        friend class SharedImage;
+        explicit Writer(Shared* shared);
+
+        Shared* shared;
+    };
+
+    SharedImage() = default;
+    explicit SharedImage(Image&& image);
+    explicit SharedImage(std::unique_ptr<Image> image);
+    SharedImage(const SharedImage& other);
+    SharedImage(SharedImage&& other);
+    ~SharedImage();
+
+    SharedImage& operator=(const SharedImage& other);
+    SharedImage& operator=(SharedImage&& other);
+
+    // The shared image, the SharedImage should not be empty
+    const Image& image() const;
+    const Image* operator->() const;
+
+    // Views the shared image, the view stays valid as long as this object references the image
+    ImageView view() const;
+
+    // Access for modification, copies the image when it is shared with other copies.
+    // An empty SharedImage gets a new empty image.
+    Writer mutableImage();
+
+    // Takes the image out of this object, the pixels are only copied when they are still shared
+    Image release();
+
+    // True when other copies reference the same image
+    bool isShared() const;
+
+    explicit operator bool() const;
+
+private:
+    void releaseReference();
+
+    Shared* shared = nullptr;
+};
+
+}
+
+#endif
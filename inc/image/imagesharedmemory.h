@@ -0,0 +1,93 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#ifndef IMAGE_SHARED_MEMORY_H
+#define IMAGE_SHARED_MEMORY_H
+
+#include <cinttypes>
+
+#include "image/image.h"
+
+namespace image
+{
+
+// Describes the pixels in a shared memory file, sent to the other process together with the
+// file descriptor. The members have a fixed size so the header can be sent as is.
+struct SharedMemoryHeader
+{
+    uint32_t    width = 0;
+    uint32_t    height = 0;
+    uint32_t    stride = 0;     // bytes between the start of two rows
+    uint32_t    format = 0;     // the PixelFormat value
+};
+
+// Image stored in an anonymous shared memory file (memfd) to pass pixels to another process
+// without copying them: the producer creates the image, writes the pixels, seals it and sends
+// fd() and header() to the consumer (e.g. with SCM_RIGHTS), which maps the pixels read-only.
+// Only supported on Linux, the functions throw on other platforms.
+class SharedMemoryImage
+{
+public:
+    SharedMemoryImage() = default;
+    SharedMemoryImage(SharedMemoryImage&& other);
+    SharedMemoryImage(const SharedMemoryImage&) = delete;
+    ~SharedMemoryImage();
+
+    SharedMemoryImage& operator=(SharedMemoryImage&& other);
+    SharedMemoryImage& operator=(const SharedMemoryImage&) = delete;
+
+    // A writable image with uninitialized pixels, the rows are padded to rowAlignment()
+    static SharedMemoryImage create(uint32_t width, uint32_t height, PixelFormat format);
+
+    // Maps the pixels of a file received from another process read-only, takes ownership of the
+    // descriptor. Throws when the file is smaller than the header describes or when it is not
+    // sealed, an unsealed file could be truncated by the sender while it is read.
+    static SharedMemoryImage import(int fd, const SharedMemoryHeader& header);
+
+    // Makes the pixels read-only: the file can no longer be written or resized by any process.
+    // The pixels are mapped again, earlier views and rows are invalidated.
+    void seal();
+
+    // The descriptor to send, it stays owned by this image
+    int fd() const;
+    SharedMemoryHeader header() const;
+
+    PixelFormat format() const;
+    bool writable() const;
+
+    // Writable rows, throws after sealing and for imported images
+    uint8_t* row(uint32_t y);
+
+    // The pixels without copying them, valid as long as this image exists
+    ImageView view() const;
+
+private:
+    void release();
+
+    int         descriptor = -1;
+    uint8_t*    data = nullptr;
+    size_t      size = 0;
+    bool        readOnly = true;
+    uint32_t    width = 0;
+    uint32_t    height = 0;
+    uint32_t    stride = 0;
+    PixelFormat pixelFormat = PixelFormat::RGB8;
+};
+
+}
+
+#endif
@@ -0,0 +1,42 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef IMAGE_SIMD_H
+#define IMAGE_SIMD_H
+
+namespace image
+{
+
+enum class SimdLevel
+{
+    None,
+    Sse41,
+    Avx2
+};
+
+// The best instruction set supported by the host cpu
+SimdLevel detectSimdLevel();
+
+// The instruction set currently used by the image processing kernels
+SimdLevel simdLevel();
+
+// Restrict the kernels to the provided instruction set (e.g. to compare against the scalar fallback)
+// Levels that are not supported by the host cpu are lowered to the detected level
+void setSimdLevel(SimdLevel level);
+
+}
+
+#endif
@@ -0,0 +1,149 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#ifndef IMAGE_TILED_H
+#define IMAGE_TILED_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cinttypes>
+
+#include "image/image.h"
+
+namespace image
+{
+
+class ILoadStore;
+
+// Image stored in square tiles, a tile is only allocated when it is first written and the tiles
+// that were never written read as zero. The least recently used tiles can be evicted to a
+// temporary file to bound the memory usage of very large images.
+// Operations process the image one tile or one row of tiles at a time. A tiled image can not be
+// used by multiple threads at once, even reading can load evicted tiles.
+class TiledImage
+{
+public:
+    static constexpr uint32_t DefaultTileSize = 256;
+
+    TiledImage();
+    TiledImage(uint32_t width, uint32_t height, PixelFormat format, uint32_t tileSize = DefaultTileSize);
+    TiledImage(TiledImage&&);
+    TiledImage(const TiledImage&) = delete;
+    ~TiledImage();
+
+    TiledImage& operator=(TiledImage&&);
+    TiledImage& operator=(const TiledImage&) = delete;
+
+    static TiledImage fromImage(const ImageView& image, uint32_t tileSize = DefaultTileSize);
+    Image toImage() const;
+
+    uint32_t width() const;
+    uint32_t height() const;
+    PixelFormat format() const;
+    uint32_t tileSize() const;
+
+    // Number of tiles horizontally and vertically
+    uint32_t columns() const;
+    uint32_t rows() const;
+
+    // Keep at most maxResidentTiles tiles in memory, the least recently used tiles are written to
+    // an unlinked temporary file in the directory. 0 keeps all tiles in memory (default).
+    // Throws on platforms without support for the temporary file.
+    void setResidentTileLimit(uint32_t maxResidentTiles, const std::string& directory);
+    uint32_t residentTiles() const;
+
+    bool isAllocated(uint32_t column, uint32_t row) const;
+
+    // The pixels of a tile, the tiles at the right and bottom edge are smaller than tileSize.
+    // The tile is valid until another tile is accessed, because that can evict it.
+    ImageView tile(uint32_t column, uint32_t row) const;
+    Image& writableTile(uint32_t column, uint32_t row);
+
+    // Copy complete rows from or to the tiles
+    void readRows(uint32_t y, uint32_t count, uint8_t* dst, uint32_t stride) const;
+    void writeRows(uint32_t y, uint32_t count, const uint8_t* src, uint32_t stride);
+
+    // Copy the pixels of width x height at x, y out of the tiles
+    void readRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint8_t* dst, uint32_t stride) const;
+
+    // Resizes one destination tile at a time, only the source pixels the tile is filtered from
+    // (its source columns and rows plus the filter margin) are copied out of the tiles, so the
+    // memory usage does not depend on the image width. The destination keeps its resident tile limit.
+    void resizeInto(TiledImage& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo) const;
+    void resizeInto(TiledImage& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options) const;
+
+private:
+    class SpillFile;
+
+    struct Tile
+    {
+        Image                           pixels;
+        bool                            stored = false;     // present in the spill file
+        bool                            dirty = false;      // modified after it was stored
+        std::list<uint32_t>::iterator   recentUse;          // position in the resident list
+    };
+
+    void reset(uint32_t newWidth, uint32_t newHeight, PixelFormat newFormat, uint32_t newTileSize);
+    Tile* access(uint32_t column, uint32_t row, bool write) const;
+    void evict(uint32_t index) const;
+    void enforceResidentLimit(uint32_t keep) const;
+
+    uint32_t                            imageWidth = 0;
+    uint32_t                            imageHeight = 0;
+    PixelFormat                         pixelFormat = PixelFormat::RGB8;
+    uint32_t                            size = DefaultTileSize;
+    uint32_t                            tileColumns = 0;
+    uint32_t                            tileRows = 0;
+
+    uint32_t                            residentLimit = 0;
+    std::string                         spillDirectory;
+
+    // tile state changes when reading evicted tiles
+    mutable std::vector<Tile>           tiles;
+    mutable std::list<uint32_t>         resident;   // most recently used first
+    mutable std::unique_ptr<SpillFile>  spill;
+
+    // read for tiles that were never written
+    std::vector<uint8_t>                zeroRow;
+};
+
+// Sequential access to the rows of a tiled image for row based consumers like the encoders:
+// a complete row of tiles is copied to a buffer at a time
+class TiledRowReader
+{
+public:
+    explicit TiledRowReader(const TiledImage& image);
+
+    // The row is valid until the next call, rows should be requested in increasing order
+    const uint8_t* row(uint32_t y);
+
+private:
+    const TiledImage&   image;
+    Image               band;
+    uint32_t            bandBegin = 0;
+    uint32_t            bandEnd = 0;
+};
+
+// Encode a tiled image with the row based store of the loadstore, one row of tiles at a time
+std::vector<uint8_t> storeToMemory(ILoadStore& store, const TiledImage& image);
+void storeToFile(ILoadStore& store, const TiledImage& image, const std::string& path);
+
+}
+
+#endif
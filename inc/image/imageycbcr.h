@@ -0,0 +1,76 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#ifndef IMAGE_YCBCR_H
+#define IMAGE_YCBCR_H
+
+#include <memory>
+#include <vector>
+#include <cinttypes>
+
+#include "image/image.h"
+
+namespace image
+{
+
+// Planar Y'CbCr image with 4:2:0 chroma subsampling, the native representation of most jpeg files
+// (full range BT.601 as defined by JFIF). The chroma planes have half the width and height of the
+// luma plane, rounded up. Every plane is a Gray8 image with its own stride.
+class YCbCrImage
+{
+public:
+    YCbCrImage() = default;
+    YCbCrImage(YCbCrImage&&) = default;
+    YCbCrImage(const YCbCrImage&) = delete;
+
+    YCbCrImage& operator=(YCbCrImage&&) = default;
+    YCbCrImage& operator=(const YCbCrImage&) = delete;
+
+    // Allocates uninitialized planes for an image of the provided dimensions
+    void allocate(uint32_t width, uint32_t height);
+
+    // The dimensions of the luma plane
+    uint32_t width() const;
+    uint32_t height() const;
+
+    // Converts Gray8, RGB8 and RGBA8 pixels (the alpha channel is dropped), the chroma
+    // samples are calculated from the average color of every 2x2 block
+    static YCbCrImage fromRgb(const ImageView& image);
+
+    // Converts to interleaved RGB8 pixels, every chroma sample is used for a 2x2 block
+    Image toRgb() const;
+
+    // Resizes every plane, the chroma planes are resized to half the new dimensions rounded up.
+    // The linearLight and premultiplyAlpha options do not apply to Y'CbCr data and are ignored.
+    void resizeInto(YCbCrImage& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo) const;
+    void resizeInto(YCbCrImage& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options) const;
+
+    Image   y;
+    Image   cb;
+    Image   cr;
+};
+
+// Jpeg data with 4:2:0 subsampling is decoded without color conversion or upsampling, other image
+// data is decoded to RGB and converted
+std::unique_ptr<YCbCrImage> loadYCbCrFromMemory(const uint8_t* pData, uint64_t dataSize);
+
+// Encodes the planes as a 4:2:0 jpeg without color conversion, throws without jpeg support
+std::vector<uint8_t> storeYCbCrToJpeg(const YCbCrImage& image);
+
+}
+
+#endif
@@ -0,0 +1,228 @@
+//    Copyright (C) 2013 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "image/image.h"
+
+#include "image/imageresizeplan.h"
+
+#include <atomic>
+#include <string>
+
+namespace image
+{
+
+static std::atomic<uint32_t> s_rowAlignment(1);
+
+void throwPixelFormatMismatch(PixelFormat expected, PixelFormat actual)
+{
+    throw std::runtime_error("Pixel format mismatch: requested format " + std::to_string(static_cast<int>(expected)) +
+                             ", the image format is " + std::to_string(static_cast<int>(actual)));
+}
+
+void setRowAlignment(uint32_t alignment)
+{
+    if (alignment == 0)
+    {
+        throw std::runtime_error("Invalid row alignment");
+    }
+
+    s_rowAlignment.store(alignment, std::memory_order_relaxed);
+}
+
+uint32_t rowAlignment()
+{
+    return s_rowAlignment.load(std::memory_order_relaxed);
+}
+
+void Image::allocate(uint32_t newWidth, uint32_t newHeight, uint32_t planes, uint32_t depth)
+{
+    const uint32_t alignment = rowAlignment();
+    const uint32_t rowBytes = newWidth * planes * (depth / 8);
+
+    width       = newWidth;
+    height      = newHeight;
+    colorPlanes = planes;
+    bitDepth    = depth;
+    stride      = ((rowBytes + alignment - 1) / alignment) * alignment;
+    data.resize(size_t(stride) * newHeight);
+}
+
+void Image::allocate(uint32_t newWidth, uint32_t newHeight, PixelFormat format)
+{
+    allocate(newWidth, newHeight, colorPlanesOf(format), bitDepthOf(format));
+}
+
+Image Image::clone() const
+{
+    Image copy;
+    copy.width = width;
+    copy.height = height;
+    copy.bitDepth = bitDepth;
+    copy.colorPlanes = colorPlanes;
+    copy.stride = stride;
+    copy.data = data;
+    return copy;
+}
+
+PixelFormat Image::format() const
+{
+    return pixelFormat(colorPlanes, bitDepth);
+}
+
+uint32_t Image::rowStride() const
+{
+    return stride != 0 ? stride : width * colorPlanes * (bitDepth / 8);
+}
+
+uint8_t* Image::row(uint32_t y)
+{
+    return data.data() + (size_t(y) * rowStride());
+}
+
+const uint8_t* Image::row(uint32_t y) const
+{
+    return data.data() + (size_t(y) * rowStride());
+}
+
+void Image::resize(uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo)
+{
+    resize(newWidth, newHeight, algo, ResizeOptions());
+}
+
+void Image::resize(uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options)
+{
+    Image resized;
+    resizeInto(resized, newWidth, newHeight, algo, options);
+    *this = std::move(resized);
+}
+
+void Image::resizeInto(Image& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo) const
+{
+    resizeInto(dst, newWidth, newHeight, algo, ResizeOptions());
+}
+
+void Image::resizeInto(Image& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options) const
+{
+    if (data.empty())
+    {
+        throw std::runtime_error("Failed to resize image, no data present");
+    }
+
+    ResizePlan(width, height, newWidth, newHeight, algo, colorPlanes, bitDepth, options.linearLight, options.premultiplyAlpha).run(*this, dst, options);
+}
+
+void Image::resizeInto(uint8_t* dst, uint32_t stride, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo) const
+{
+    resizeInto(dst, stride, newWidth, newHeight, algo, ResizeOptions());
+}
+
+void Image::resizeInto(uint8_t* dst, uint32_t stride, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options) const
+{
+    if (data.empty())
+    {
+        throw std::runtime_error("Failed to resize image, no data present");
+    }
+
+    ResizePlan(width, height, newWidth, newHeight, algo, colorPlanes, bitDepth, options.linearLight, options.premultiplyAlpha).run(*this, dst, stride, options);
+}
+
+ImageView Image::crop(uint32_t x, uint32_t y, uint32_t cropWidth, uint32_t cropHeight) const
+{
+    return ImageView(*this).crop(x, y, cropWidth, cropHeight);
+}
+
+ImageView::ImageView(const uint8_t* data, uint32_t width, uint32_t height, uint32_t stride, uint32_t colorPlanes, uint32_t bitDepth)
+: data(data)
+, width(width)
+, height(height)
+, bitDepth(bitDepth)
+, colorPlanes(colorPlanes)
+, stride(stride)
+{
+}
+
+ImageView::ImageView(const uint8_t* data, uint32_t width, uint32_t height, uint32_t stride, PixelFormat format)
+: ImageView(data, width, height, stride, colorPlanesOf(format), bitDepthOf(format))
+{
+}
+
+ImageView::ImageView(const Image& image)
+: data(image.data.data())
+, width(image.width)
+, height(image.height)
+, bitDepth(image.bitDepth)
+, colorPlanes(image.colorPlanes)
+, stride(image.rowStride())
+{
+    const size_t rowBytes = size_t(width) * colorPlanes * (bitDepth / 8);
+    if (width > 0 && height > 0 && image.data.size() < (size_t(height - 1) * stride) + rowBytes)
+    {
+        throw std::runtime_error("Failed to create image view, the image data is smaller than the image dimensions");
+    }
+}
+
+ImageView ImageView::crop(uint32_t x, uint32_t y, uint32_t cropWidth, uint32_t cropHeight) const
+{
+    if (uint64_t(x) + cropWidth > width || uint64_t(y) + cropHeight > height)
+    {
+        throw std::runtime_error("Failed to crop image, the region is outside of the image");
+    }
+
+    const uint32_t pixelSize = colorPlanes * (bitDepth / 8);
+    return ImageView(row(y) + (x * pixelSize), cropWidth, cropHeight, stride, colorPlanes, bitDepth);
+}
+
+PixelFormat ImageView::format() const
+{
+    return pixelFormat(colorPlanes, bitDepth);
+}
+
+const uint8_t* ImageView::row(uint32_t y) const
+{
+    return data + (size_t(y) * stride);
+}
+
+void ImageView::resizeInto(Image& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo) const
+{
+    resizeInto(dst, newWidth, newHeight, algo, ResizeOptions());
+}
+
+void ImageView::resizeInto(Image& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options) const
+{
+    if (data == nullptr)
+    {
+        throw std::runtime_error("Failed to resize image, no data present");
+    }
+
+    ResizePlan(width, height, newWidth, newHeight, algo, colorPlanes, bitDepth, options.linearLight, options.premultiplyAlpha).run(*this, dst, options);
+}
+
+void ImageView::resizeInto(uint8_t* dst, uint32_t dstStride, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo) const
+{
+    resizeInto(dst, dstStride, newWidth, newHeight, algo, ResizeOptions());
+}
+
+void ImageView::resizeInto(uint8_t* dst, uint32_t dstStride, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options) const
+{
+    if (data == nullptr)
+    {
+        throw std::runtime_error("Failed to resize image, no data present");
+    }
+
+    ResizePlan(width, height, newWidth, newHeight, algo, colorPlanes, bitDepth, options.linearLight, options.premultiplyAlpha).run(*this, dst, dstStride, options);
+}
+
+}
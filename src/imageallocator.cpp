@@ -0,0 +1,443 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#include "image/imageallocator.h"
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <cstdlib>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+namespace image
+{
+
+static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+static std::atomic<bool> s_hugePages(false);
+
+static std::mutex s_fileBackingMutex;
+static std::string s_fileBackingDirectory;
+static std::atomic<size_t> s_fileBackingMinimumSize(0);
+
+static std::atomic<size_t> s_mappedCount(0);
+
+// Mapped buffers that are still in use with their size, only accessed with the mutex locked
+static std::unordered_map<void*, size_t>& mappedPixels()
+{
+    // never destroyed, images with static storage duration can still release their buffers
+    static auto* mapped = new std::unordered_map<void*, size_t>();
+    return *mapped;
+}
+
+#ifndef _WIN32
+static void* mapPixelFile(size_t size)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(s_fileBackingMutex);
+        path = s_fileBackingDirectory + "/imagepixelsXXXXXX";
+    }
+
+    auto fd = mkstemp(&path[0]);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to create pixel file, " + path);
+    }
+
+    // only the mapping keeps the file alive from now on
+    unlink(path.c_str());
+
+#ifdef __linux__
+    // reserve the disk space, writing to a sparse file on a full disk raises SIGBUS
+    const bool sized = posix_fallocate(fd, 0, static_cast<off_t>(size)) == 0;
+#else
+    const bool sized = ftruncate(fd, static_cast<off_t>(size)) == 0;
+#endif
+
+    void* memory = sized ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if (memory == MAP_FAILED)
+    {
+        throw std::runtime_error("Failed to map pixel file, " + std::to_string(size) + " bytes in " + path);
+    }
+
+    try
+    {
+        std::lock_guard<std::mutex> lock(s_fileBackingMutex);
+        mappedPixels().emplace(memory, size);
+        ++s_mappedCount;
+    }
+    catch (...)
+    {
+        munmap(memory, size);
+        throw;
+    }
+
+    return memory;
+}
+#endif
+
+static bool unmapPixelFile(void* memory)
+{
+#ifndef _WIN32
+    if (s_mappedCount.load() == 0)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(s_fileBackingMutex);
+    auto& mapped = mappedPixels();
+    auto iter = mapped.find(memory);
+    if (iter == mapped.end())
+    {
+        return false;
+    }
+
+    munmap(memory, iter->second);
+    mapped.erase(iter);
+    --s_mappedCount;
+    return true;
+#else
+    (void)memory;
+    return false;
+#endif
+}
+
+static void* allocateAligned(size_t size, size_t alignment)
+{
+#ifndef _WIN32
+    // the mapping is page aligned
+    const auto fileBackingSize = s_fileBackingMinimumSize.load(std::memory_order_relaxed);
+    if (fileBackingSize > 0 && size >= fileBackingSize && alignment <= size_t(sysconf(_SC_PAGESIZE)))
+    {
+        return mapPixelFile(size);
+    }
+#endif
+
+    const bool hugePages = s_hugePages.load(std::memory_order_relaxed) && size >= HugePageSize;
+    if (hugePages)
+    {
+        alignment = std::max(alignment, HugePageSize);
+    }
+
+    void* memory = nullptr;
+#ifdef _WIN32
+    memory = _aligned_malloc(size, alignment);
+#else
+    if (posix_memalign(&memory, alignment, size) != 0)
+    {
+        memory = nullptr;
+    }
+#endif
+
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+#ifdef __linux__
+    if (hugePages)
+    {
+        // only a hint, the memory is still usable when the kernel does not support it
+        madvise(memory, size, MADV_HUGEPAGE);
+    }
+#endif
+
+    return memory;
+}
+
+static void deallocateAligned(void* memory, size_t /*size*/, size_t /*alignment*/)
+{
+    if (unmapPixelFile(memory))
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+static std::atomic<PixelAllocateFunction> s_allocate(allocateAligned);
+static std::atomic<PixelDeallocateFunction> s_deallocate(deallocateAligned);
+
+static constexpr int MinPooledExponent = 16;
+static constexpr int MaxPooledExponent = sizeof(size_t) >= 8 ? 40 : 30;
+static constexpr size_t MinPooledSize = size_t(1) << MinPooledExponent;
+static constexpr size_t MaxPooledSize = size_t(1) << MaxPooledExponent;
+static constexpr int BucketsPerPowerOfTwo = 4;
+static constexpr size_t BucketCount = (MaxPooledExponent - MinPooledExponent) * BucketsPerPowerOfTwo + 1;
+
+static std::atomic<size_t> s_poolCapacity(0);
+
+static int floorLog2(size_t value)
+{
+    int result = 0;
+    while (value >>= 1)
+    {
+        ++result;
+    }
+
+    return result;
+}
+
+static bool isPooledSize(size_t size)
+{
+    return size >= MinPooledSize && size <= MaxPooledSize;
+}
+
+// Rounds up to a multiple of a quarter of the largest power of two not above the size
+static size_t bucketSize(size_t size)
+{
+    const size_t step = size_t(1) << (floorLog2(size) - 2);
+    return (size + step - 1) & ~(step - 1);
+}
+
+static size_t bucketIndex(size_t bucketSize)
+{
+    const int exponent = floorLog2(bucketSize);
+    const auto quarters = bucketSize >> (exponent - 2);
+    return (exponent - MinPooledExponent) * BucketsPerPowerOfTwo + quarters - BucketsPerPowerOfTwo;
+}
+
+// Buffers allocated while the pool is enabled are rounded up to their bucket, the pool keeps track
+// of them so they are released with that size even when the pool is disabled in the meantime
+class PixelPool
+{
+public:
+    void* take(size_t size)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& bucket = buckets[bucketIndex(size)];
+        if (bucket.empty())
+        {
+            ++statistics.misses;
+            return nullptr;
+        }
+
+        ++statistics.hits;
+        statistics.retainedBytes -= size;
+        auto* memory = bucket.back();
+        bucket.pop_back();
+        return memory;
+    }
+
+    // records a buffer of a bucket size handed out to an image
+    void track(void* memory, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inUse.emplace(memory, size);
+        trackedCount.store(inUse.size(), std::memory_order_relaxed);
+    }
+
+    // the bucket size of a tracked buffer, 0 when the buffer was allocated with its exact size
+    size_t untrack(void* memory) noexcept
+    {
+        if (trackedCount.load(std::memory_order_relaxed) == 0)
+        {
+            return 0;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = inUse.find(memory);
+        if (iter == inUse.end())
+        {
+            return 0;
+        }
+
+        const auto size = iter->second;
+        inUse.erase(iter);
+        trackedCount.store(inUse.size(), std::memory_order_relaxed);
+        return size;
+    }
+
+    bool retain(void* memory, size_t size, size_t capacity) noexcept
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (statistics.retainedBytes + size > capacity)
+        {
+            return false;
+        }
+
+        try
+        {
+            buckets[bucketIndex(size)].push_back(memory);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return false;
+        }
+
+        statistics.retainedBytes += size;
+        return true;
+    }
+
+    void clear()
+    {
+        std::array<std::vector<void*>, BucketCount> retained;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            retained.swap(buckets);
+            statistics.retainedBytes = 0;
+        }
+
+        for (size_t i = 0; i < retained.size(); ++i)
+        {
+            const size_t exponent = MinPooledExponent + i / BucketsPerPowerOfTwo;
+            const size_t size = (BucketsPerPowerOfTwo + i % BucketsPerPowerOfTwo) << (exponent - 2);
+            for (auto* memory : retained[i])
+            {
+                s_deallocate.load(std::memory_order_relaxed)(memory, size, PixelAlignment);
+            }
+        }
+    }
+
+    PixelPoolStatistics getStatistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return statistics;
+    }
+
+private:
+    std::mutex mutex;
+    std::array<std::vector<void*>, BucketCount> buckets;
+    std::unordered_map<void*, size_t> inUse;
+    std::atomic<size_t> trackedCount{0};
+    PixelPoolStatistics statistics;
+};
+
+static PixelPool& pixelPool()
+{
+    // never destroyed, images with static storage duration can still release their buffers
+    static auto* pool = new PixelPool();
+    return *pool;
+}
+
+void setPixelAllocator(PixelAllocateFunction allocate, PixelDeallocateFunction deallocate)
+{
+    // the retained buffers belong to the previous allocator
+    pixelPool().clear();
+    s_allocate.store(allocate ? allocate : allocateAligned, std::memory_order_relaxed);
+    s_deallocate.store(deallocate ? deallocate : deallocateAligned, std::memory_order_relaxed);
+}
+
+void setPixelFileBacking(const std::string& directory, size_t minimumSize)
+{
+#ifdef _WIN32
+    if (!directory.empty())
+    {
+        throw std::runtime_error("Failed to enable file backed pixels, not supported on this platform");
+    }
+#else
+    std::lock_guard<std::mutex> lock(s_fileBackingMutex);
+    s_fileBackingDirectory = directory;
+#endif
+
+    s_fileBackingMinimumSize.store(directory.empty() ? 0 : std::max<size_t>(minimumSize, 1), std::memory_order_relaxed);
+}
+
+void setPixelHugePages(bool enabled)
+{
+    s_hugePages.store(enabled, std::memory_order_relaxed);
+}
+
+void setPixelPoolCapacity(size_t maxRetainedBytes)
+{
+    s_poolCapacity.store(maxRetainedBytes, std::memory_order_relaxed);
+    if (pixelPool().getStatistics().retainedBytes > maxRetainedBytes)
+    {
+        pixelPool().clear();
+    }
+}
+
+void clearPixelPool()
+{
+    pixelPool().clear();
+}
+
+PixelPoolStatistics pixelPoolStatistics()
+{
+    return pixelPool().getStatistics();
+}
+
+// Sizes are only rounded up to their bucket while the pool is enabled, the other buffers are
+// allocated with their exact size
+void* allocatePixels(size_t size)
+{
+    if (!isPooledSize(size) || s_poolCapacity.load(std::memory_order_relaxed) == 0)
+    {
+        return s_allocate.load(std::memory_order_relaxed)(size, PixelAlignment);
+    }
+
+    size = bucketSize(size);
+    auto* memory = pixelPool().take(size);
+    if (memory == nullptr)
+    {
+        memory = s_allocate.load(std::memory_order_relaxed)(size, PixelAlignment);
+    }
+
+    try
+    {
+        pixelPool().track(memory, size);
+    }
+    catch (...)
+    {
+        s_deallocate.load(std::memory_order_relaxed)(memory, size, PixelAlignment);
+        throw;
+    }
+
+    return memory;
+}
+
+void deallocatePixels(void* memory, size_t size) noexcept
+{
+    if (isPooledSize(size))
+    {
+        // only buffers of a bucket size can be reused by the pool
+        const auto bucketed = pixelPool().untrack(memory);
+        if (bucketed != 0)
+        {
+            size = bucketed;
+
+            const auto capacity = s_poolCapacity.load(std::memory_order_relaxed);
+            if (capacity > 0 && pixelPool().retain(memory, size, capacity))
+            {
+                return;
+            }
+        }
+    }
+
+    s_deallocate.load(std::memory_order_relaxed)(memory, size, PixelAlignment);
+}
+
+}
@@ -26,6 +26,7 @@
 #include "utils/stringoperations.h"
 
 #include "image/image.h"
+#include "image/imageloadstoreinterface.h"
 #include "imageconfig.h"
 
 #if HAVE_JPEG
@@ -52,10 +53,10 @@ static std::unique_ptr<Image> loadImage(utils::IReader& reader)
 }
 
 template <typename LoaderType>
-static std::unique_ptr<Image> loadImageFromMemory(const uint8_t* pData, uint64_t dataSize)
+static std::unique_ptr<Image> loadImageFromMemory(const uint8_t* pData, uint64_t dataSize, const DecodeOptions& options)
 {
     LoaderType loader;
-    return loader.loadFromMemory(pData, dataSize);
+    return loader.loadFromMemory(pData, dataSize, options);
 }
 
 Type detectImageTypeFromUri(const std::string& uri)
@@ -142,12 +143,45 @@ std::unique_ptr<Image> Factory::createFromUri(const std::string& uri, Type image
     }
 }
 
+std::unique_ptr<Image> Factory::createFromUri(const std::string& uri, const DecodeOptions& options)
+{
+    try
+    {
+        return createFromUri(uri, detectImageTypeFromUri(uri), options);
+    }
+    catch (std::exception& e)
+    {
+        log::warn(e.what());
+        std::rethrow_exception(std::current_exception());
+    }
+}
+
+std::unique_ptr<Image> Factory::createFromUri(const std::string& uri, Type imageType, const DecodeOptions& options)
+{
+    // the reduced decodes work on memory, so the complete file is read first
+    std::unique_ptr<utils::IReader> reader(ReaderFactory::create(uri));
+    reader->open(uri);
+
+    auto data = reader->readAllData();
+    return createFromData(data.data(), data.size(), imageType, options);
+}
+
 std::unique_ptr<Image> Factory::createFromData(const std::vector<uint8_t>& data)
 {
     return createFromData(data.data(), data.size());
 }
 
 std::unique_ptr<Image> Factory::createFromData(const uint8_t* pData, uint64_t dataSize)
+{
+    return createFromData(pData, dataSize, DecodeOptions());
+}
+
+std::unique_ptr<Image> Factory::createFromData(const std::vector<uint8_t>& data, const DecodeOptions& options)
+{
+    return createFromData(data.data(), data.size(), options);
+}
+
+std::unique_ptr<Image> Factory::createFromData(const uint8_t* pData, uint64_t dataSize, const DecodeOptions& options)
 {
     // try to detect the image type from the provided data
 
@@ -155,7 +189,7 @@ std::unique_ptr<Image> Factory::createFromData(const uint8_t* pData, uint64_t da
     LoadStoreJpeg loadStoreJpeg;
     if (loadStoreJpeg.isValidImageData(pData, dataSize))
     {
-        return loadStoreJpeg.loadFromMemory(pData, dataSize);
+        return loadStoreJpeg.loadFromMemory(pData, dataSize, options);
     }
 #endif
 
@@ -163,31 +197,41 @@ std::unique_ptr<Image> Factory::createFromData(const uint8_t* pData, uint64_t da
     LoadStorePng loadStorePng;
     if (loadStorePng.isValidImageData(pData, dataSize))
     {
-        return loadStorePng.loadFromMemory(pData, dataSize);
+        return loadStorePng.loadFromMemory(pData, dataSize, options);
     }
 #endif
 
     throw std::runtime_error("Provided image data not supported");
 }
 
-std::unique_ptr<Image> Factory::createFromData(const std::vector<uint8_t>& data, Type /*imageType*/)
+std::unique_ptr<Image> Factory::createFromData(const std::vector<uint8_t>& data, Type imageType)
 {
-    return createFromData(data.data(), data.size());
+    return createFromData(data.data(), data.size(), imageType);
 }
 
 std::unique_ptr<Image> Factory::createFromData(const uint8_t* pData, uint64_t dataSize, Type imageType)
+{
+    return createFromData(pData, dataSize, imageType, DecodeOptions());
+}
+
+std::unique_ptr<Image> Factory::createFromData(const std::vector<uint8_t>& data, Type imageType, const DecodeOptions& options)
+{
+    return createFromData(data.data(), data.size(), imageType, options);
+}
+
+std::unique_ptr<Image> Factory::createFromData(const uint8_t* pData, uint64_t dataSize, Type imageType, const DecodeOptions& options)
 {
     switch (imageType)
     {
     case Type::Jpeg:
 #if HAVE_JPEG
-        return loadImageFromMemory<LoadStoreJpeg>(pData, dataSize);
+        return loadImageFromMemory<LoadStoreJpeg>(pData, dataSize, options);
 #else
         throw std::runtime_error("Library not compiled with jpeg support");
 #endif
     case Type::Png:
 #if HAVE_PNG
-        return loadImageFromMemory<LoadStorePng>(pData, dataSize);
+        return loadImageFromMemory<LoadStorePng>(pData, dataSize, options);
 #else
         throw std::runtime_error("Library not compiled with png support");
 #endif
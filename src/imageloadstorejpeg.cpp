@@ -15,9 +15,11 @@
 //    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "imageloadstorejpeg.h"
+#include <algorithm>
 #include <stdexcept>
 #include <cassert>
 #include <cstring>
+#include <functional>
 
 #include "utils/log.h"
 #include "utils/fileoperations.h"
@@ -95,6 +97,11 @@ struct LoadStoreJpegData
 };
 
 static constexpr int JPEG_WORK_BUFFER_SIZE = 8192;
+static constexpr int JpegQuality = 85;
+
+// Rows decoded per call when the rows can not be decoded into the image directly, the height of
+// an iMCU row of a 4:2:0 image
+static constexpr uint32_t JpegBatchRows = 16;
 static void jpegInitDestination(j_compress_ptr pCompressionInfo);
 static boolean jpegFlushWorkBuffer(j_compress_ptr pCompressionInfo);
 static void jpegDestroyDestination(j_compress_ptr pCompressionInfo);
@@ -128,6 +135,35 @@ std::unique_ptr<Image> LoadStoreJpeg::loadFromReader(utils::IReader& reader)
 }
 
 std::unique_ptr<Image> LoadStoreJpeg::loadFromMemory(const uint8_t* pData, uint64_t dataSize)
+{
+    return loadFromMemory(pData, dataSize, DecodeOptions());
+}
+
+// The scale denominator for the inverse DCT: the requested one, or the largest one that still
+// produces the minimum size
+static uint32_t decodeScaleDenominator(const jpeg_decompress_struct& decomp, const DecodeOptions& options)
+{
+    if (options.minimumWidth == 0 && options.minimumHeight == 0)
+    {
+        if (options.scaleDenominator != 1 && options.scaleDenominator != 2 && options.scaleDenominator != 4 && options.scaleDenominator != 8)
+        {
+            throw std::runtime_error("Failed to decode jpeg, unsupported scale 1/" + std::to_string(options.scaleDenominator));
+        }
+
+        return options.scaleDenominator;
+    }
+
+    uint32_t denominator = 8;
+    while (denominator > 1 && (((decomp.image_width + denominator - 1) / denominator) < options.minimumWidth ||
+                               ((decomp.image_height + denominator - 1) / denominator) < options.minimumHeight))
+    {
+        denominator /= 2;
+    }
+
+    return denominator;
+}
+
+std::unique_ptr<Image> LoadStoreJpeg::loadFromMemory(const uint8_t* pData, uint64_t dataSize, const DecodeOptions& options)
 {
     auto image = std::make_unique<Image>();
 
@@ -141,13 +177,15 @@ std::unique_ptr<Image> LoadStoreJpeg::loadFromMemory(const uint8_t* pData, uint6
         throw std::runtime_error("Invalid JPEG data recieved");
     }
 
+    // the inverse DCT produces the reduced size directly, most of the decoding work is skipped
+    decomp.scale_num = 1;
+    decomp.scale_denom = decodeScaleDenominator(decomp, options);
+
     jpeg_start_decompress(&decomp);
 
-	image->width        = decomp.output_width;
-	image->height       = decomp.output_height;
-	image->bitDepth     = decomp.data_precision;
-    image->colorPlanes  = 3; // output color space is always RGB
-    image->data.resize(image->width * image->height * image->colorPlanes);
+    // grayscale images are decoded as gray, the other color spaces are converted to RGB
+    const auto format = decomp.out_color_space == JCS_GRAYSCALE ? PixelFormat::Gray8 : PixelFormat::RGB8;
+    image->allocate(decomp.output_width, decomp.output_height, format);
 
 	// Now that you have the decompressor entirely configured, it's time
 	// to read out all of the scanlines of the jpeg.
@@ -164,36 +202,53 @@ std::unique_ptr<Image> LoadStoreJpeg::loadFromMemory(const uint8_t* pData, uint6
 
     if (decomp.out_color_space == JCS_CMYK)
     {
-        // we need to convert CMYK to rgb
-        std::vector<uint8_t> row(decomp.image_width * decomp.output_components);
-        JSAMPROW rowPointer[1];
-        rowPointer[0] = row.data();
+        // we need to convert CMYK to rgb, the rows are decoded in batches into a buffer
+        const uint32_t batchRows = std::max<uint32_t>(decomp.rec_outbuf_height, JpegBatchRows);
+        const uint32_t rowSize = decomp.output_width * decomp.output_components;
+        std::vector<uint8_t> rows(size_t(batchRows) * rowSize);
+        std::vector<JSAMPROW> rowPointers(batchRows);
+        for (uint32_t i = 0; i < batchRows; ++i)
+        {
+            rowPointers[i] = &rows[size_t(i) * rowSize];
+        }
+
         while (decomp.output_scanline < decomp.output_height)
         {
-            auto startOffset = decomp.output_scanline * decomp.image_width * image->colorPlanes;
-            jpeg_read_scanlines(&decomp, rowPointer, 1);
+            const uint32_t firstRow = decomp.output_scanline;
+            const uint32_t count = jpeg_read_scanlines(&decomp, rowPointers.data(), batchRows);
 
-            // now convert the decoded row to rgb
-            for (uint32_t i = 0; i < decomp.image_width; ++i)
+            // now convert the decoded rows to rgb
+            for (uint32_t r = 0; r < count; ++r)
             {
-                float c = row[i * decomp.output_components] / 255.f;
-                float m = row[i * decomp.output_components + 1] / 255.f;
-                float y = row[i * decomp.output_components + 2] / 255.f;
-                float k = row[i * decomp.output_components + 3] / 255.f;
-
-                image->data[startOffset + (i * 3)    ] = static_cast<uint8_t>(255.f * c * k);
-                image->data[startOffset + (i * 3) + 1] = static_cast<uint8_t>(255.f * m * k);
-                image->data[startOffset + (i * 3) + 2] = static_cast<uint8_t>(255.f * y * k);
+                const auto* row = rowPointers[r];
+                auto* dst = image->row(firstRow + r);
+                for (uint32_t i = 0; i < decomp.output_width; ++i)
+                {
+                    float c = row[i * decomp.output_components] / 255.f;
+                    float m = row[i * decomp.output_components + 1] / 255.f;
+                    float y = row[i * decomp.output_components + 2] / 255.f;
+                    float k = row[i * decomp.output_components + 3] / 255.f;
+
+                    dst[(i * 3)    ] = static_cast<uint8_t>(255.f * c * k);
+                    dst[(i * 3) + 1] = static_cast<uint8_t>(255.f * m * k);
+                    dst[(i * 3) + 2] = static_cast<uint8_t>(255.f * y * k);
+                }
             }
         }
     }
     else
     {
-        JSAMPROW rowPointer[1];
+        // all remaining rows are offered on every call, so the decoder can output a complete
+        // iMCU row at once instead of buffering it and returning it one row at a time
+        std::vector<JSAMPROW> rowPointers(decomp.output_height);
+        for (uint32_t y = 0; y < decomp.output_height; ++y)
+        {
+            rowPointers[y] = image->row(y);
+        }
+
         while (decomp.output_scanline < decomp.output_height)
         {
-            rowPointer[0] = (unsigned char*)(&image->data[decomp.output_scanline * decomp.image_width * decomp.output_components]);
-            jpeg_read_scanlines(&decomp, rowPointer, 1);
+            jpeg_read_scanlines(&decomp, &rowPointers[decomp.output_scanline], decomp.output_height - decomp.output_scanline);
         }
     }
 
@@ -207,20 +262,13 @@ std::unique_ptr<Image> LoadStoreJpeg::loadFromMemory(const std::vector<uint8_t>&
     return loadFromMemory(data.data(), data.size());
 }
 
-void LoadStoreJpeg::storeToFile(const Image& image, const std::string& path)
+void LoadStoreJpeg::storeToFile(const ImageView& image, const std::string& path)
 {
     utils::fileops::writeFile(storeToMemory(image), path);
 }
 
-std::vector<uint8_t> LoadStoreJpeg::storeToMemory(const Image& image)
+static void setBufferDestination(jpeg_compress_struct& comp, std::vector<uint8_t>& jpegData)
 {
-    constexpr int quality = 85;
-
-    LoadStoreJpegData jpeg(LoadStoreJpegData::Operation::Compress);
-
-    std::vector<uint8_t> jpegData;
-
-    auto& comp = jpeg.compression;
     comp.dest = (jpeg_destination_mgr*)(comp.mem->alloc_small) ((j_common_ptr) &comp, JPOOL_PERMANENT, sizeof(BufferWriter));
 
     BufferWriter* pWriter = reinterpret_cast<BufferWriter*>(comp.dest);
@@ -228,37 +276,52 @@ std::vector<uint8_t> LoadStoreJpeg::storeToMemory(const Image& image)
     pWriter->destMgr.empty_output_buffer    = jpegFlushWorkBuffer;
     pWriter->destMgr.term_destination       = jpegDestroyDestination;
     pWriter->dataSink                       = &jpegData;
+}
+
+// Encodes the rows in increasing order, so images that are not completely in memory can be stored
+static std::vector<uint8_t> storeRows(PixelFormat format, uint32_t width, uint32_t height, const std::function<const uint8_t*(uint32_t)>& row)
+{
+    LoadStoreJpegData jpeg(LoadStoreJpegData::Operation::Compress);
+
+    std::vector<uint8_t> jpegData;
+
+    auto& comp = jpeg.compression;
+    setBufferDestination(comp, jpegData);
+
+    if (bitDepthOf(format) != 8)
+    {
+        throw std::runtime_error("Failed to store jpeg, only images with a bit depth of 8 are supported");
+    }
 
-    comp.image_width         = image.width;
-    comp.image_height        = image.height;
-    comp.input_components    = image.colorPlanes == 4 ? 3 : image.colorPlanes; // drop the alpha channel
+    comp.image_width         = width;
+    comp.image_height        = height;
+    comp.input_components    = hasAlpha(format) ? colorPlanesOf(format) - 1 : colorPlanesOf(format); // drop the alpha channel
     comp.in_color_space      = comp.input_components == 3 ? JCS_RGB : JCS_GRAYSCALE;
 
-    if (image.colorPlanes == 4)
+    if (hasAlpha(format))
     {
         log::warn("Dropping alpha channel when saving to jpeg");
     }
 
     jpeg_set_defaults(&comp);
-    jpeg_set_quality(&comp, quality, TRUE);
+    jpeg_set_quality(&comp, JpegQuality, TRUE);
     jpeg_start_compress(&comp, TRUE);
 
     JSAMPROW rowPointer[1];
 
-    if (image.colorPlanes == 4)
+    if (hasAlpha(format))
     {
-        std::vector<uint8_t> row(image.width * image.height * 3);
+        const uint32_t planes = colorPlanesOf(format);
+        std::vector<uint8_t> colorRow(width * comp.input_components);
         while (comp.next_scanline < comp.image_height)
         {
-            auto offset = comp.next_scanline * image.width * image.colorPlanes;
-            for (uint32_t i = 0; i < image.width; ++i)
+            auto* src = row(comp.next_scanline);
+            for (uint32_t i = 0; i < width; ++i)
             {
-                row[i * comp.input_components]      = image.data[offset + (i*4)];
-                row[i * comp.input_components + 1]  = image.data[offset + (i*4) + 1];
-                row[i * comp.input_components + 2]  = image.data[offset + (i*4) + 2];
+                std::copy(src + (i * planes), src + (i * planes) + comp.input_components, &colorRow[i * comp.input_components]);
             }
 
-            rowPointer[0] = row.data();
+            rowPointer[0] = colorRow.data();
             (void) jpeg_write_scanlines(&comp, rowPointer, 1);
         }
     }
@@ -266,7 +329,7 @@ std::vector<uint8_t> LoadStoreJpeg::storeToMemory(const Image& image)
     {
         while (comp.next_scanline < comp.image_height)
         {
-            rowPointer[0] = (unsigned char*)(&image.data[comp.next_scanline * comp.image_width * comp.input_components]);
+            rowPointer[0] = const_cast<JSAMPROW>(row(comp.next_scanline));
             (void) jpeg_write_scanlines(&comp, rowPointer, 1);
         }
     }
@@ -276,6 +339,183 @@ std::vector<uint8_t> LoadStoreJpeg::storeToMemory(const Image& image)
     return jpegData;
 }
 
+std::vector<uint8_t> LoadStoreJpeg::storeToMemory(const ImageView& image)
+{
+    return storeRows(image.format(), image.width, image.height, [&] (uint32_t y) {
+        return image.row(y);
+    });
+}
+
+std::vector<uint8_t> LoadStoreJpeg::storeRowsToMemory(PixelFormat format, uint32_t width, uint32_t height, const RowFunction& row)
+{
+    return storeRows(format, width, height, row);
+}
+
+// The raw data of one iMCU row of a 4:2:0 jpeg: 16 luma rows and 8 rows of both chroma components
+class RawRows
+{
+public:
+    // the luma rows are padded to complete MCUs of 2x2 blocks
+    RawRows(uint32_t lumaBlocks, uint32_t chromaBlocks)
+    : lumaWidth(((lumaBlocks + 1) / 2) * 2 * DCTSIZE)
+    , chromaWidth(chromaBlocks * DCTSIZE)
+    , buffer((LumaRows * lumaWidth) + (2 * ChromaRows * chromaWidth))
+    {
+        for (uint32_t i = 0; i < LumaRows; ++i)
+        {
+            luma[i] = &buffer[i * lumaWidth];
+        }
+
+        for (uint32_t i = 0; i < ChromaRows; ++i)
+        {
+            cb[i] = &buffer[(LumaRows * lumaWidth) + (i * chromaWidth)];
+            cr[i] = &buffer[(LumaRows * lumaWidth) + ((ChromaRows + i) * chromaWidth)];
+        }
+
+        components[0] = luma;
+        components[1] = cb;
+        components[2] = cr;
+    }
+
+    // Copies the decoded rows that are part of the image into the planes
+    void copyTo(YCbCrImage& image, uint32_t firstRow) const
+    {
+        copyRows(luma, LumaRows, image.y, firstRow);
+        copyRows(cb, ChromaRows, image.cb, firstRow / 2);
+        copyRows(cr, ChromaRows, image.cr, firstRow / 2);
+    }
+
+    // Fills the rows from the planes, the last row and column are repeated to complete the blocks
+    void copyFrom(const YCbCrImage& image, uint32_t firstRow)
+    {
+        fillRows(luma, LumaRows, lumaWidth, image.y, firstRow);
+        fillRows(cb, ChromaRows, chromaWidth, image.cb, firstRow / 2);
+        fillRows(cr, ChromaRows, chromaWidth, image.cr, firstRow / 2);
+    }
+
+    static constexpr uint32_t LumaRows = 2 * DCTSIZE;
+    static constexpr uint32_t ChromaRows = DCTSIZE;
+
+    JSAMPARRAY components[3];
+
+private:
+    static void copyRows(const JSAMPROW* rows, uint32_t count, Image& plane, uint32_t firstRow)
+    {
+        for (uint32_t i = 0; i < count && firstRow + i < plane.height; ++i)
+        {
+            std::copy(rows[i], rows[i] + plane.width, plane.row(firstRow + i));
+        }
+    }
+
+    static void fillRows(JSAMPROW* rows, uint32_t count, uint32_t width, const Image& plane, uint32_t firstRow)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const uint8_t* src = plane.row(std::min(firstRow + i, plane.height - 1));
+            std::copy(src, src + plane.width, rows[i]);
+            std::fill(rows[i] + plane.width, rows[i] + width, src[plane.width - 1]);
+        }
+    }
+
+    uint32_t                lumaWidth;
+    uint32_t                chromaWidth;
+    std::vector<uint8_t>    buffer;
+    JSAMPROW                luma[LumaRows];
+    JSAMPROW                cb[ChromaRows];
+    JSAMPROW                cr[ChromaRows];
+};
+
+static bool isYCbCr420(const jpeg_decompress_struct& decomp)
+{
+    return decomp.jpeg_color_space == JCS_YCbCr &&
+           decomp.num_components == 3 &&
+           decomp.comp_info[0].h_samp_factor == 2 && decomp.comp_info[0].v_samp_factor == 2 &&
+           decomp.comp_info[1].h_samp_factor == 1 && decomp.comp_info[1].v_samp_factor == 1 &&
+           decomp.comp_info[2].h_samp_factor == 1 && decomp.comp_info[2].v_samp_factor == 1;
+}
+
+std::unique_ptr<YCbCrImage> LoadStoreJpeg::loadYCbCrFromMemory(const uint8_t* pData, uint64_t dataSize)
+{
+    LoadStoreJpegData jpeg(LoadStoreJpegData::Operation::Decompress);
+
+    auto& decomp = jpeg.decompression;
+
+    jpeg_mem_src(&decomp, const_cast<uint8_t*>(pData), dataSize);
+    if (1 != jpeg_read_header(&decomp, TRUE))
+    {
+        throw std::runtime_error("Invalid JPEG data recieved");
+    }
+
+    if (!isYCbCr420(decomp))
+    {
+        // other color spaces and subsamplings are converted from rgb
+        return std::make_unique<YCbCrImage>(YCbCrImage::fromRgb(*loadFromMemory(pData, dataSize)));
+    }
+
+    // read the downsampled components without color conversion
+    decomp.raw_data_out = TRUE;
+    jpeg_start_decompress(&decomp);
+
+    auto image = std::make_unique<YCbCrImage>();
+    image->allocate(decomp.output_width, decomp.output_height);
+
+    RawRows rows(decomp.comp_info[0].width_in_blocks, decomp.comp_info[1].width_in_blocks);
+    while (decomp.output_scanline < decomp.output_height)
+    {
+        const uint32_t firstRow = decomp.output_scanline;
+        if (jpeg_read_raw_data(&decomp, rows.components, RawRows::LumaRows) == 0)
+        {
+            throw std::runtime_error("Failed to read jpeg data");
+        }
+
+        rows.copyTo(*image, firstRow);
+    }
+
+    jpeg_finish_decompress(&decomp);
+
+    return image;
+}
+
+std::vector<uint8_t> LoadStoreJpeg::storeYCbCrToMemory(const YCbCrImage& image)
+{
+    LoadStoreJpegData jpeg(LoadStoreJpegData::Operation::Compress);
+
+    std::vector<uint8_t> jpegData;
+
+    auto& comp = jpeg.compression;
+    setBufferDestination(comp, jpegData);
+
+    comp.image_width         = image.width();
+    comp.image_height        = image.height();
+    comp.input_components    = 3;
+    comp.in_color_space      = JCS_YCbCr;
+
+    jpeg_set_defaults(&comp);
+    jpeg_set_quality(&comp, JpegQuality, TRUE);
+
+    // the planes are passed to the encoder without color conversion or downsampling
+    comp.raw_data_in = TRUE;
+    comp.comp_info[0].h_samp_factor = 2;
+    comp.comp_info[0].v_samp_factor = 2;
+    comp.comp_info[1].h_samp_factor = 1;
+    comp.comp_info[1].v_samp_factor = 1;
+    comp.comp_info[2].h_samp_factor = 1;
+    comp.comp_info[2].v_samp_factor = 1;
+
+    jpeg_start_compress(&comp, TRUE);
+
+    RawRows rows(comp.comp_info[0].width_in_blocks, comp.comp_info[1].width_in_blocks);
+    while (comp.next_scanline < comp.image_height)
+    {
+        rows.copyFrom(image, comp.next_scanline);
+        (void) jpeg_write_raw_data(&comp, rows.components, RawRows::LumaRows);
+    }
+
+    jpeg_finish_compress(&comp);
+
+    return jpegData;
+}
+
 static void jpegInitDestination(j_compress_ptr pCompressionInfo)
 {
     BufferWriter* pWriter = reinterpret_cast<BufferWriter*>(pCompressionInfo->dest);
@@ -23,6 +23,7 @@
 
 #include "utils/readerinterface.h"
 #include "image/imageloadstoreinterface.h"
+#include "image/imageycbcr.h"
 
 namespace image
 {
@@ -42,9 +43,16 @@ public:
     virtual std::unique_ptr<Image> loadFromReader(utils::IReader& reader) override;
     virtual std::unique_ptr<Image> loadFromMemory(const uint8_t* pData, uint64_t dataSize) override;
     virtual std::unique_ptr<Image> loadFromMemory(const std::vector<uint8_t>& data) override;
+    virtual std::unique_ptr<Image> loadFromMemory(const uint8_t* pData, uint64_t dataSize, const DecodeOptions& options) override;
     
-    virtual void storeToFile(const Image& image, const std::string& path) override;
-    virtual std::vector<uint8_t> storeToMemory(const Image& image) override;
+    virtual void storeToFile(const ImageView& image, const std::string& path) override;
+    virtual std::vector<uint8_t> storeToMemory(const ImageView& image) override;
+    virtual std::vector<uint8_t> storeRowsToMemory(PixelFormat format, uint32_t width, uint32_t height, const RowFunction& row) override;
+
+    // Jpeg specific: planar Y'CbCr 4:2:0 data is read and written without color conversion or
+    // upsampling, other color spaces and subsamplings are converted from RGB
+    std::unique_ptr<YCbCrImage> loadYCbCrFromMemory(const uint8_t* pData, uint64_t dataSize);
+    std::vector<uint8_t> storeYCbCrToMemory(const YCbCrImage& image);
 };
 
 }
@@ -15,9 +15,11 @@
 //    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "imageloadstorepng.h"
+#include <algorithm>
 #include <stdexcept>
 #include <cassert>
 #include <cstring>
+#include <functional>
 #include <png.h>
 
 #include "utils/log.h"
@@ -100,6 +102,13 @@ static void readDataFromReaderCallback(png_structp png_ptr, png_bytep data, png_
 
 constexpr uint32_t PngSignatureLength = 8;
 
+// png stores 16-bit samples in network byte order, images keep them in native byte order
+static bool isLittleEndian()
+{
+    const uint16_t value = 1;
+    return *reinterpret_cast<const uint8_t*>(&value) == 1;
+}
+
 LoadStorePng::~LoadStorePng() = default;
 
 bool LoadStorePng::isValidImageData(const std::vector<uint8_t>& data)
@@ -136,9 +145,9 @@ std::unique_ptr<Image> LoadStorePng::loadFromReader(utils::IReader& reader)
     readImageProperties(png, *image);
 
     std::vector<png_bytep> rowPointers(image->height, nullptr);
-    for (size_t y = 0; y < image->height; ++y)
+    for (uint32_t y = 0; y < image->height; ++y)
     {
-        rowPointers[y] = (png_bytep)(&image->data[image->width * y * image->colorPlanes]);
+        rowPointers[y] = (png_bytep)(image->row(y));
     }
 
     png_read_image(png, rowPointers.data());
@@ -162,9 +171,9 @@ std::unique_ptr<Image> LoadStorePng::loadFromMemory(const uint8_t* pData, uint64
     readImageProperties(png, *image);
 
     std::vector<png_bytep> rowPointers(image->height, nullptr);
-    for (size_t y = 0; y < image->height; ++y)
+    for (uint32_t y = 0; y < image->height; ++y)
     {
-        rowPointers[y] = (png_bytep)(&image->data[image->width * y * image->colorPlanes]);
+        rowPointers[y] = (png_bytep)(image->row(y));
     }
 
     png_read_image(png, rowPointers.data());
@@ -178,25 +187,40 @@ std::unique_ptr<Image> LoadStorePng::loadFromMemory(const std::vector<uint8_t>&
     return loadFromMemory(data.data(), data.size());
 }
 
-static int32_t colorTypeFromColorPlanes(uint32_t colorPlanes)
+std::unique_ptr<Image> LoadStorePng::loadFromMemory(const uint8_t* pData, uint64_t dataSize, const DecodeOptions& /*options*/)
+{
+    // png can not decode at a reduced size cheaper than decoding it completely
+    return loadFromMemory(pData, dataSize);
+}
+
+static int32_t colorTypeFromFormat(PixelFormat format)
 {
-    switch (colorPlanes)
+    switch (format)
     {
-    case 4: return PNG_COLOR_TYPE_RGB_ALPHA;
-    case 3: return PNG_COLOR_TYPE_RGB;
-    case 2: return PNG_COLOR_TYPE_GRAY_ALPHA;
-    case 1: return PNG_COLOR_TYPE_GRAY;
-    default:
-        throw std::runtime_error("Invalid number of dataplanes in image");
+    case PixelFormat::RGBA8:
+    case PixelFormat::RGBA16:
+        return PNG_COLOR_TYPE_RGB_ALPHA;
+    case PixelFormat::RGB8:
+    case PixelFormat::RGB16:
+        return PNG_COLOR_TYPE_RGB;
+    case PixelFormat::GrayA8:
+    case PixelFormat::GrayA16:
+        return PNG_COLOR_TYPE_GRAY_ALPHA;
+    case PixelFormat::Gray8:
+    case PixelFormat::Gray16:
+        return PNG_COLOR_TYPE_GRAY;
     }
+
+    throw std::runtime_error("Invalid pixel format");
 }
 
-void LoadStorePng::storeToFile(const Image& image, const std::string& path)
+void LoadStorePng::storeToFile(const ImageView& image, const std::string& path)
 {
     utils::fileops::writeFile(storeToMemory(image), path);
 }
 
-std::vector<uint8_t> LoadStorePng::storeToMemory(const Image& image)
+// Encodes the rows in increasing order, so images that are not completely in memory can be stored
+static std::vector<uint8_t> storeRows(PixelFormat format, uint32_t width, uint32_t height, const std::function<const uint8_t*(uint32_t)>& row)
 {
     PngPointers png(PngPointers::Operation::Write);
 
@@ -209,23 +233,37 @@ std::vector<uint8_t> LoadStorePng::storeToMemory(const Image& image)
 		throw logic_error("Writing png file failed");
 	}
 
-	png_set_IHDR(png, png, image.width, image.height, image.bitDepth, colorTypeFromColorPlanes(image.colorPlanes),
+	png_set_IHDR(png, png, width, height, bitDepthOf(format), colorTypeFromFormat(format),
                  PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 
+    png_write_info(png, png);
+    if (bitDepthOf(format) == 16 && isLittleEndian())
+    {
+        png_set_swap(png);
+    }
 
-    std::vector<png_bytep> rowPointers(image.height, nullptr);
-    for (size_t y = 0; y < image.height; ++y)
+    for (uint32_t y = 0; y < height; ++y)
     {
-        rowPointers[y] = (png_bytep)(&image.data[image.width * y * image.colorPlanes]);
+        png_write_row(png, const_cast<png_bytep>(row(y)));
     }
 
-    png_set_rows(png, png, rowPointers.data());
-    png_write_png(png, png, 0, nullptr);
     png_write_end(png, nullptr);
 
     return pngData;
 }
 
+std::vector<uint8_t> LoadStorePng::storeToMemory(const ImageView& image)
+{
+    return storeRows(image.format(), image.width, image.height, [&] (uint32_t y) {
+        return image.row(y);
+    });
+}
+
+std::vector<uint8_t> LoadStorePng::storeRowsToMemory(PixelFormat format, uint32_t width, uint32_t height, const RowFunction& row)
+{
+    return storeRows(format, width, height, row);
+}
+
 void LoadStorePng::verifyPNGSignature(const uint8_t* pData)
 {
     if (!png_check_sig(pData, PngSignatureLength))
@@ -248,34 +286,56 @@ static void readImageProperties(PngPointers& png, Image& image)
         throw std::runtime_error("Filed to read png header");
     }
 
-    image.width     = width;
-    image.height    = height;
-    image.bitDepth  = static_cast<uint32_t>(bitDepth);
+    if (bitDepth == 16 && isLittleEndian())
+    {
+        png_set_swap(png);
+    }
 
+    // palettes and gray samples of less than 8 bits are expanded to 8 bit samples
+    if (colorType == PNG_COLOR_TYPE_PALETTE)
+    {
+        png_set_palette_to_rgb(png);
+    }
+    else if (colorType == PNG_COLOR_TYPE_GRAY && bitDepth < 8)
+    {
+        png_set_expand_gray_1_2_4_to_8(png);
+    }
+
+    bitDepth = std::max(bitDepth, 8);
+
+    // a transparency chunk adds an alpha channel to gray, rgb and palette images
+    const bool transparency = png_get_valid(png, png, PNG_INFO_tRNS) != 0;
+    if (transparency)
+    {
+        png_set_tRNS_to_alpha(png);
+    }
+
+    uint32_t colorPlanes = 0;
     switch (colorType)
     {
     case PNG_COLOR_TYPE_GRAY:
-        image.colorPlanes = 1;
+        colorPlanes = transparency ? 2 : 1;
         break;
     case PNG_COLOR_TYPE_GRAY_ALPHA:
-        image.colorPlanes = 2;
+        colorPlanes = 2;
         break;
     case PNG_COLOR_TYPE_RGB:
-        image.colorPlanes = 3;
+        colorPlanes = transparency ? 4 : 3;
         break;
     case PNG_COLOR_TYPE_RGB_ALPHA:
-        image.colorPlanes = 4;
+        colorPlanes = 4;
         break;
     case PNG_COLOR_TYPE_PALETTE:
-        png_set_palette_to_rgb(png);
-        image.colorPlanes = 4;
+        colorPlanes = transparency ? 4 : 3;
         break;
     default:
         throw std::runtime_error("Unsupported PNG color type encountered");
     }
 
+    png_read_update_info(png, png);
+
     // reserve the necessary memory
-    image.data.resize(width * height * (bitDepth / 8) * image.colorPlanes);
+    image.allocate(width, height, pixelFormat(colorPlanes, static_cast<uint32_t>(bitDepth)));
 }
 
 //void LoadStorePng::setText(const string& key, const string& value)
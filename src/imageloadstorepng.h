@@ -42,9 +42,11 @@ public:
     virtual std::unique_ptr<Image> loadFromReader(utils::IReader& reader) override;
     virtual std::unique_ptr<Image> loadFromMemory(const uint8_t* pData, uint64_t dataSize) override;
     virtual std::unique_ptr<Image> loadFromMemory(const std::vector<uint8_t>& data) override;
+    virtual std::unique_ptr<Image> loadFromMemory(const uint8_t* pData, uint64_t dataSize, const DecodeOptions& options) override;
     
-    virtual void storeToFile(const Image& image, const std::string& path) override;
-    virtual std::vector<uint8_t> storeToMemory(const Image& image) override;
+    virtual void storeToFile(const ImageView& image, const std::string& path) override;
+    virtual std::vector<uint8_t> storeToMemory(const ImageView& image) override;
+    virtual std::vector<uint8_t> storeRowsToMemory(PixelFormat format, uint32_t width, uint32_t height, const RowFunction& row) override;
     
     // Png specific operation
     // void setText(const std::string& key, const std::string& value);
@@ -0,0 +1,125 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "imageparallel.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace image
+{
+
+// Bands smaller than this are not worth the synchronisation overhead
+static constexpr uint32_t MinimumBandRows = 16;
+
+void forEachBand(uint32_t rows, const ResizeOptions& options, const std::function<void(uint32_t begin, uint32_t end)>& func)
+{
+    const uint32_t threads = options.threads == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : options.threads;
+    const uint32_t bands = std::max(std::min(threads, rows / MinimumBandRows), 1u);
+
+    if (bands == 1)
+    {
+        func(0, rows);
+        return;
+    }
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    uint32_t pending = bands - 1;
+    std::exception_ptr error;
+
+    auto runBand = [&] (uint32_t band) {
+        const auto begin = static_cast<uint32_t>((uint64_t(rows) * band) / bands);
+        const auto end = static_cast<uint32_t>((uint64_t(rows) * (band + 1)) / bands);
+
+        try
+        {
+            func(begin, end);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> spawnedThreads;
+    bool submitFailed = false;
+
+    for (uint32_t band = 1; band < bands; ++band)
+    {
+        auto task = [&, band] () {
+            runBand(band);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            --pending;
+            finished.notify_one();
+        };
+
+        try
+        {
+            if (options.executor)
+            {
+                options.executor(task);
+            }
+            else
+            {
+                spawnedThreads.emplace_back(task);
+            }
+        }
+        catch (...)
+        {
+            // the remaining bands will never run, wait for the submitted ones and report the error
+            std::lock_guard<std::mutex> lock(mutex);
+            pending -= bands - band;
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+            submitFailed = true;
+            break;
+        }
+    }
+
+    if (!submitFailed)
+    {
+        runBand(0);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] () { return pending == 0; });
+    }
+
+    for (auto& thread : spawnedThreads)
+    {
+        thread.join();
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+}
@@ -0,0 +1,35 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef IMAGE_PARALLEL_H
+#define IMAGE_PARALLEL_H
+
+#include <functional>
+#include <cinttypes>
+
+#include "image/image.h"
+
+namespace image
+{
+
+// Splits the rows in horizontal bands and calls func(begin, end) for every band.
+// The bands are processed concurrently as configured in the options, the first exception
+// thrown by a band is rethrown once all bands are finished.
+void forEachBand(uint32_t rows, const ResizeOptions& options, const std::function<void(uint32_t begin, uint32_t end)>& func);
+
+}
+
+#endif
@@ -0,0 +1,110 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#include "image/imagepixelformat.h"
+
+#include <stdexcept>
+
+namespace image
+{
+
+static_assert(sizeof(Pixel<PixelFormat::RGB8>) == 3, "Pixels must not be padded");
+static_assert(sizeof(Pixel<PixelFormat::RGB16>) == 6, "Pixels must not be padded");
+
+PixelFormat pixelFormat(uint32_t colorPlanes, uint32_t bitDepth)
+{
+    if (bitDepth == 8)
+    {
+        switch (colorPlanes)
+        {
+        case 1: return PixelFormat::Gray8;
+        case 2: return PixelFormat::GrayA8;
+        case 3: return PixelFormat::RGB8;
+        case 4: return PixelFormat::RGBA8;
+        default: break;
+        }
+    }
+    else if (bitDepth == 16)
+    {
+        switch (colorPlanes)
+        {
+        case 1: return PixelFormat::Gray16;
+        case 2: return PixelFormat::GrayA16;
+        case 3: return PixelFormat::RGB16;
+        case 4: return PixelFormat::RGBA16;
+        default: break;
+        }
+    }
+    else
+    {
+        throw std::runtime_error("Unsupported pixel format, only bit depths of 8 and 16 are supported");
+    }
+
+    throw std::runtime_error("Unsupported pixel format, only 1 to 4 color planes are supported");
+}
+
+uint32_t colorPlanesOf(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::Gray8:
+    case PixelFormat::Gray16:
+        return 1;
+    case PixelFormat::GrayA8:
+    case PixelFormat::GrayA16:
+        return 2;
+    case PixelFormat::RGB8:
+    case PixelFormat::RGB16:
+        return 3;
+    case PixelFormat::RGBA8:
+    case PixelFormat::RGBA16:
+        return 4;
+    }
+
+    throw std::runtime_error("Invalid pixel format");
+}
+
+uint32_t bitDepthOf(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::Gray8:
+    case PixelFormat::GrayA8:
+    case PixelFormat::RGB8:
+    case PixelFormat::RGBA8:
+        return 8;
+    case PixelFormat::Gray16:
+    case PixelFormat::GrayA16:
+    case PixelFormat::RGB16:
+    case PixelFormat::RGBA16:
+        return 16;
+    }
+
+    throw std::runtime_error("Invalid pixel format");
+}
+
+uint32_t pixelSizeOf(PixelFormat format)
+{
+    return colorPlanesOf(format) * (bitDepthOf(format) / 8);
+}
+
+bool hasAlpha(PixelFormat format)
+{
+    return colorPlanesOf(format) % 2 == 0;
+}
+
+}
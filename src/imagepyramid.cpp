@@ -0,0 +1,187 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#include "image/imagepyramid.h"
+
+#include "imageresize.h"
+
+namespace image
+{
+
+namespace
+{
+
+// Produces the levels depth first: as soon as two rows of a level are available the next level
+// row is calculated, so the rows of every level are still in the cache when they are reduced again
+class PyramidBuilder
+{
+public:
+    PyramidBuilder(resize::HalveRowFunction halveRow, size_t pixelSize)
+    : halveRow(halveRow)
+    , pixelSize(pixelSize)
+    {
+    }
+
+    void addLevel(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, size_t srcStride, uint8_t* dst)
+    {
+        levels.push_back({ src, srcWidth, srcHeight, srcStride, dst });
+    }
+
+    void run()
+    {
+        const uint32_t rows = (levels.front().srcHeight + 1) / 2;
+        for (uint32_t y = 0; y < rows; ++y)
+        {
+            produceRow(0, y);
+        }
+    }
+
+private:
+    struct Level
+    {
+        const uint8_t*  src;
+        uint32_t        srcWidth;
+        uint32_t        srcHeight;
+        size_t          srcStride;
+        uint8_t*        dst;
+    };
+
+    void produceRow(size_t index, uint32_t y)
+    {
+        const Level& level = levels[index];
+        const size_t srcStride = level.srcStride;
+        const size_t dstStride = ((level.srcWidth + 1) / 2) * pixelSize;
+
+        const uint8_t* rows[2];
+        rows[0] = level.src + ((y * 2) * srcStride);
+        rows[1] = level.src + (std::min((y * 2) + 1, level.srcHeight - 1) * srcStride);
+        halveRow(rows, level.srcWidth, level.dst + (y * dstStride));
+
+        // the row completes a pair of rows of the next level or is its last row
+        const uint32_t height = (level.srcHeight + 1) / 2;
+        if (index + 1 < levels.size() && (y % 2 == 1 || y == height - 1))
+        {
+            produceRow(index + 1, y / 2);
+        }
+    }
+
+    resize::HalveRowFunction    halveRow;
+    size_t                      pixelSize;
+    std::vector<Level>          levels;
+};
+
+}
+
+ImagePyramid::ImagePyramid(const Image& src, uint32_t minimumSize)
+: planes(src.colorPlanes)
+, depth(src.bitDepth)
+{
+    const auto halveRow = resize::selectHalveRow(src.colorPlanes, src.bitDepth);
+    const size_t pixelSize = src.colorPlanes * (src.bitDepth / 8);
+
+    if (src.width == 0 || src.height == 0 || src.data.size() < (size_t(src.height - 1) * src.rowStride()) + (src.width * pixelSize))
+    {
+        throw std::runtime_error("Failed to create image pyramid, no data present");
+    }
+
+    minimumSize = std::max(minimumSize, 1u);
+
+    size_t size = 0;
+    uint32_t width = src.width;
+    uint32_t height = src.height;
+    while ((width > 1 || height > 1) && (width + 1) / 2 >= minimumSize && (height + 1) / 2 >= minimumSize)
+    {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+
+        levelInfo.push_back({ width, height, size });
+        size += size_t(width) * height * pixelSize;
+    }
+
+    if (levelInfo.empty())
+    {
+        return;
+    }
+
+    buffer.resize(size);
+
+    PyramidBuilder builder(halveRow, pixelSize);
+    builder.addLevel(src.data.data(), src.width, src.height, src.rowStride(), buffer.data());
+    for (size_t i = 1; i < levelInfo.size(); ++i)
+    {
+        const Level& previous = levelInfo[i - 1];
+        builder.addLevel(&buffer[previous.offset], previous.width, previous.height, previous.width * pixelSize, &buffer[levelInfo[i].offset]);
+    }
+
+    builder.run();
+}
+
+uint32_t ImagePyramid::levels() const
+{
+    return static_cast<uint32_t>(levelInfo.size());
+}
+
+uint32_t ImagePyramid::width(uint32_t level) const
+{
+    return this->level(level).width;
+}
+
+uint32_t ImagePyramid::height(uint32_t level) const
+{
+    return this->level(level).height;
+}
+
+uint32_t ImagePyramid::colorPlanes() const
+{
+    return planes;
+}
+
+uint32_t ImagePyramid::bitDepth() const
+{
+    return depth;
+}
+
+const uint8_t* ImagePyramid::data(uint32_t level) const
+{
+    return &buffer[this->level(level).offset];
+}
+
+Image ImagePyramid::image(uint32_t level) const
+{
+    const Level& info = this->level(level);
+    const uint8_t* samples = &buffer[info.offset];
+
+    Image result;
+    result.width = info.width;
+    result.height = info.height;
+    result.colorPlanes = planes;
+    result.bitDepth = depth;
+    result.data.assign(samples, samples + (size_t(info.width) * info.height * planes * (depth / 8)));
+    return result;
+}
+
+const ImagePyramid::Level& ImagePyramid::level(uint32_t index) const
+{
+    if (index >= levelInfo.size())
+    {
+        throw std::runtime_error("Invalid image pyramid level requested");
+    }
+
+    return levelInfo[index];
+}
+
+}
@@ -0,0 +1,334 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#include "image/imagerawfile.h"
+
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <io.h>
+#endif
+
+namespace image
+{
+
+static constexpr char RawMagic[8] = { 'I', 'M', 'G', 'R', 'A', 'W', '\0', '\0' };
+static constexpr uint32_t RawVersion = 1;
+static constexpr uint32_t RawByteOrder = 0x01020304;
+static constexpr uint64_t RawDataOffset = 4096;
+
+struct RawHeader
+{
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    byteOrder;      // detects files written on a machine with another byte order
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    stride;
+    uint32_t    format;
+    uint64_t    dataOffset;
+    uint64_t    dataSize;
+    uint64_t    checksum;
+};
+
+// FNV-1a on 64-bit words instead of bytes, detects corrupt files without slowing down storing
+class Checksum
+{
+public:
+    // the size has to be a multiple of 8 except for the last update
+    void update(const uint8_t* data, size_t size)
+    {
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            hash = (hash ^ word) * Prime;
+        }
+
+        for (; i < size; ++i)
+        {
+            hash = (hash ^ data[i]) * Prime;
+        }
+    }
+
+    uint64_t value() const
+    {
+        return hash;
+    }
+
+private:
+    static constexpr uint64_t Prime = 1099511628211ull;
+    uint64_t hash = 14695981039346656037ull;
+};
+
+RawImageFile::RawImageFile(RawImageFile&& other)
+{
+    *this = std::move(other);
+}
+
+RawImageFile::~RawImageFile()
+{
+    release();
+}
+
+RawImageFile& RawImageFile::operator=(RawImageFile&& other)
+{
+    if (this != &other)
+    {
+        release();
+        mapping = std::exchange(other.mapping, nullptr);
+        size = std::exchange(other.size, 0);
+    }
+
+    return *this;
+}
+
+void RawImageFile::release()
+{
+#ifndef _WIN32
+    if (mapping != nullptr)
+    {
+        munmap(mapping, size);
+    }
+#endif
+
+    mapping = nullptr;
+    size = 0;
+}
+
+// Creates a uniquely named file in the directory of the path, so writers storing the same path
+// at the same time do not write to the same temporary file
+static FILE* createTemporaryFile(const std::string& path, std::string& temporaryPath)
+{
+    temporaryPath = path + ".XXXXXX";
+
+#ifndef _WIN32
+    const int fd = mkstemp(&temporaryPath[0]);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    auto* file = fdopen(fd, "wb");
+    if (file == nullptr)
+    {
+        close(fd);
+        std::remove(temporaryPath.c_str());
+    }
+
+    return file;
+#else
+    if (_mktemp_s(&temporaryPath[0], temporaryPath.size() + 1) != 0)
+    {
+        return nullptr;
+    }
+
+    return std::fopen(temporaryPath.c_str(), "wb");
+#endif
+}
+
+// Flushes the written data to the storage device, so a crash after the rename can not leave a
+// truncated file behind the final path
+static bool syncFile(FILE* file)
+{
+    if (std::fflush(file) != 0)
+    {
+        return false;
+    }
+
+#ifndef _WIN32
+    return fsync(fileno(file)) == 0;
+#else
+    return _commit(_fileno(file)) == 0;
+#endif
+}
+
+// Makes the rename itself durable, the directory entry lives in the parent directory
+static bool syncDirectory(const std::string& path)
+{
+#ifndef _WIN32
+    const auto separator = path.rfind('/');
+    const std::string directory = separator == std::string::npos ? "." : path.substr(0, std::max<size_t>(separator, 1));
+
+    const int fd = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    const bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+#else
+    (void)path;
+    return true;
+#endif
+}
+
+void RawImageFile::storeToFile(const ImageView& image, const std::string& path)
+{
+    const auto format = image.format();
+    const uint32_t rowBytes = image.width * pixelSizeOf(format);
+
+    RawHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, RawMagic, sizeof(RawMagic));
+    header.version = RawVersion;
+    header.byteOrder = RawByteOrder;
+    header.width = image.width;
+    header.height = image.height;
+    header.stride = static_cast<uint32_t>(((rowBytes + PixelAlignment - 1) / PixelAlignment) * PixelAlignment);
+    header.format = static_cast<uint32_t>(format);
+    header.dataOffset = RawDataOffset;
+    header.dataSize = uint64_t(header.stride) * image.height;
+
+    std::string temporaryPath;
+    auto* file = createTemporaryFile(path, temporaryPath);
+    if (file == nullptr)
+    {
+        throw std::runtime_error("Failed to store raw image file, could not create a temporary file for " + path);
+    }
+
+    const std::vector<char> headerBlock(RawDataOffset, 0);
+    bool written = std::fwrite(headerBlock.data(), 1, headerBlock.size(), file) == headerBlock.size();
+
+    // the stride is a multiple of 8, so the checksum can be calculated row by row
+    Checksum checksum;
+    std::vector<uint8_t> row(header.stride, 0);
+    for (uint32_t y = 0; written && y < image.height; ++y)
+    {
+        std::copy(image.row(y), image.row(y) + rowBytes, row.begin());
+        checksum.update(row.data(), row.size());
+        written = std::fwrite(row.data(), 1, row.size(), file) == row.size();
+    }
+
+    header.checksum = checksum.value();
+    written = written && std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, file) == 1;
+    written = written && syncFile(file);
+
+    if (std::fclose(file) != 0 || !written)
+    {
+        std::remove(temporaryPath.c_str());
+        throw std::runtime_error("Failed to store raw image file, could not write " + temporaryPath);
+    }
+
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporaryPath.c_str());
+        throw std::runtime_error("Failed to store raw image file, could not rename " + temporaryPath);
+    }
+
+    if (!syncDirectory(path))
+    {
+        throw std::runtime_error("Failed to store raw image file, could not sync the directory of " + path);
+    }
+}
+
+RawImageFile RawImageFile::loadFromFile(const std::string& path)
+{
+#ifndef _WIN32
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to load raw image file, could not open " + path);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || uint64_t(info.st_size) < RawDataOffset)
+    {
+        close(fd);
+        throw std::runtime_error("Failed to load raw image file, invalid file " + path);
+    }
+
+    auto* memory = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+    {
+        throw std::runtime_error("Failed to load raw image file, could not map " + path);
+    }
+
+    RawImageFile file;
+    file.mapping = static_cast<uint8_t*>(memory);
+    file.size = size_t(info.st_size);
+
+    RawHeader header;
+    std::memcpy(&header, file.mapping, sizeof(header));
+    if (std::memcmp(header.magic, RawMagic, sizeof(RawMagic)) != 0 || header.version != RawVersion || header.byteOrder != RawByteOrder)
+    {
+        throw std::runtime_error("Failed to load raw image file, unsupported file " + path);
+    }
+
+    // throws for values that are not a pixel format
+    const uint64_t rowBytes = uint64_t(header.width) * pixelSizeOf(static_cast<PixelFormat>(header.format));
+    if (header.stride < rowBytes || header.dataOffset != RawDataOffset ||
+        header.dataSize != uint64_t(header.stride) * header.height ||
+        header.dataOffset + header.dataSize > file.size)
+    {
+        throw std::runtime_error("Failed to load raw image file, corrupt header in " + path);
+    }
+
+    return file;
+#else
+    (void)path;
+    throw std::runtime_error("Failed to load raw image file, not supported on this platform");
+#endif
+}
+
+bool RawImageFile::verify() const
+{
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+
+    RawHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+
+    Checksum checksum;
+    checksum.update(mapping + header.dataOffset, header.dataSize);
+    return checksum.value() == header.checksum;
+}
+
+PixelFormat RawImageFile::format() const
+{
+    return view().format();
+}
+
+ImageView RawImageFile::view() const
+{
+    if (mapping == nullptr)
+    {
+        return ImageView();
+    }
+
+    RawHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    return ImageView(mapping + header.dataOffset, header.width, header.height, header.stride, static_cast<PixelFormat>(header.format));
+}
+
+}
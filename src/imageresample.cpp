@@ -0,0 +1,297 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "imageresize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "imageparallel.h"
+
+namespace image
+{
+namespace resize
+{
+
+namespace
+{
+
+struct Filter
+{
+    double support;
+    double (*weight)(double x);
+};
+
+constexpr double Pi = 3.14159265358979323846;
+
+// Keys cubic convolution with a = -0.5
+double bicubic(double x)
+{
+    constexpr double a = -0.5;
+
+    x = std::fabs(x);
+    if (x < 1.0)
+    {
+        return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+    }
+
+    if (x < 2.0)
+    {
+        return (((x - 5.0) * x + 8.0) * x - 4.0) * a;
+    }
+
+    return 0.0;
+}
+
+// Mitchell-Netravali cubic with B = C = 1/3
+double mitchell(double x)
+{
+    constexpr double b = 1.0 / 3.0;
+    constexpr double c = 1.0 / 3.0;
+
+    x = std::fabs(x);
+    if (x < 1.0)
+    {
+        return ((12.0 - 9.0 * b - 6.0 * c) * x * x * x + (-18.0 + 12.0 * b + 6.0 * c) * x * x + (6.0 - 2.0 * b)) / 6.0;
+    }
+
+    if (x < 2.0)
+    {
+        return ((-b - 6.0 * c) * x * x * x + (6.0 * b + 30.0 * c) * x * x + (-12.0 * b - 48.0 * c) * x + (8.0 * b + 24.0 * c)) / 6.0;
+    }
+
+    return 0.0;
+}
+
+double sinc(double x)
+{
+    if (x == 0.0)
+    {
+        return 1.0;
+    }
+
+    x *= Pi;
+    return std::sin(x) / x;
+}
+
+double lanczos3(double x)
+{
+    if (x > -3.0 && x < 3.0)
+    {
+        return sinc(x) * sinc(x / 3.0);
+    }
+
+    return 0.0;
+}
+
+Filter filterForAlgorithm(ResizeAlgorithm algo)
+{
+    switch (algo)
+    {
+    case ResizeAlgorithm::Bicubic:      return { 2.0, bicubic };
+    case ResizeAlgorithm::Mitchell:     return { 2.0, mitchell };
+    case ResizeAlgorithm::Lanczos3:     return { 3.0, lanczos3 };
+    default:
+        throw std::invalid_argument("Resize algorithm is not a separable filter");
+    }
+}
+
+// 16-bit samples multiplied with the filter weights can overflow 32-bit accumulators
+template <typename Sample> struct Accumulator { using type = int32_t; };
+template <> struct Accumulator<uint16_t> { using type = int64_t; };
+
+template <typename Sample, typename Sum>
+inline Sample clampToSample(Sum value)
+{
+    constexpr Sum maximum = std::numeric_limits<Sample>::max();
+    value = (value + (Sum(1) << (WeightPrecision - 1))) >> WeightPrecision;
+    return static_cast<Sample>(std::min(std::max(value, Sum(0)), maximum));
+}
+
+// Filters the destination columns [begin, end) of the rows, the destination rows only hold those columns
+template <typename Pixel>
+void resampleHorizontal(const uint8_t* src, uint32_t srcStride, uint8_t* dst, const Range& columnRange, uint32_t rows, const Contributions& columns)
+{
+    using Sample = typename Pixel::Sample;
+    using Sum = typename Accumulator<Sample>::type;
+
+    const uint32_t dstStride = (columnRange.last - columnRange.first) * Pixel::size;
+
+    for (uint32_t y = 0; y < rows; ++y)
+    {
+        const Sample* srcRow = reinterpret_cast<const Sample*>(src + (y * srcStride));
+        Sample* dstRow = reinterpret_cast<Sample*>(dst + (y * dstStride));
+
+        for (uint32_t x = columnRange.first; x < columnRange.last; ++x)
+        {
+            const int16_t* weights = &columns.weights[x * columns.taps];
+            const Sample* pixel = srcRow + (columns.first[x] * Pixel::channels);
+
+            Sum sum[Pixel::channels] = {};
+            for (uint32_t tap = 0; tap < columns.count[x]; ++tap)
+            {
+                for (uint32_t i = 0; i < Pixel::channels; ++i)
+                {
+                    sum[i] += Sum(pixel[(tap * Pixel::channels) + i]) * weights[tap];
+                }
+            }
+
+            for (uint32_t i = 0; i < Pixel::channels; ++i)
+            {
+                dstRow[((x - columnRange.first) * Pixel::channels) + i] = clampToSample<Sample>(sum[i]);
+            }
+        }
+    }
+}
+
+// The rows of the source hold the destination columns starting at firstColumn
+template <typename Pixel>
+void resampleVertical(const uint8_t* src, uint32_t firstRow, uint32_t firstColumn, uint32_t stride, const Target& dst, uint32_t begin, uint32_t end, const Contributions& rows)
+{
+    using Sample = typename Pixel::Sample;
+    using Sum = typename Accumulator<Sample>::type;
+
+    const uint32_t samples = stride / sizeof(Sample);
+
+    for (uint32_t y = begin; y < end; ++y)
+    {
+        const int16_t* weights = &rows.weights[y * rows.taps];
+        const uint8_t* column = src + ((rows.first[y] - firstRow) * stride);
+        Sample* dstRow = reinterpret_cast<Sample*>(dst.row(y) + (firstColumn * Pixel::size));
+
+        for (uint32_t x = 0; x < samples; ++x)
+        {
+            Sum sum = 0;
+            for (uint32_t tap = 0; tap < rows.count[y]; ++tap)
+            {
+                sum += Sum(reinterpret_cast<const Sample*>(column + (tap * stride))[x]) * weights[tap];
+            }
+
+            dstRow[x] = clampToSample<Sample>(sum);
+        }
+    }
+}
+
+}
+
+Contributions calculateContributions(uint32_t srcSize, uint32_t dstSize, ResizeAlgorithm algo)
+{
+    const auto filter = filterForAlgorithm(algo);
+
+    // when reducing, the filter is stretched so every source pixel contributes to the result
+    const double scale = static_cast<double>(srcSize) / dstSize;
+    const double filterScale = std::max(scale, 1.0);
+    const double support = filter.support * filterScale;
+
+    Contributions contributions;
+    contributions.taps = static_cast<uint32_t>(std::ceil(support)) * 2 + 1;
+    contributions.first.resize(dstSize);
+    contributions.count.resize(dstSize);
+    contributions.weights.resize(dstSize * contributions.taps, 0);
+
+    std::vector<double> weights(contributions.taps);
+
+    for (uint32_t i = 0; i < dstSize; ++i)
+    {
+        const double center = (i + 0.5) * scale;
+        const auto first = static_cast<uint32_t>(std::max(center - support + 0.5, 0.0));
+        const auto last = static_cast<uint32_t>(std::min(center + support + 0.5, static_cast<double>(srcSize)));
+        const uint32_t count = std::min(last - first, contributions.taps);
+
+        double total = 0.0;
+        for (uint32_t tap = 0; tap < count; ++tap)
+        {
+            weights[tap] = filter.weight((first + tap - center + 0.5) / filterScale);
+            total += weights[tap];
+        }
+
+        // normalize, so a flat area remains flat near the edges
+        int16_t* fixedWeights = &contributions.weights[i * contributions.taps];
+        int32_t fixedTotal = 0;
+        uint32_t largest = 0;
+        for (uint32_t tap = 0; tap < count; ++tap)
+        {
+            const double weight = total != 0.0 ? weights[tap] / total : 0.0;
+            fixedWeights[tap] = static_cast<int16_t>(std::lround(weight * (1 << WeightPrecision)));
+            fixedTotal += fixedWeights[tap];
+
+            if (fixedWeights[tap] > fixedWeights[largest])
+            {
+                largest = tap;
+            }
+        }
+
+        // compensate the rounding errors, so the weights add up exactly
+        fixedWeights[largest] += static_cast<int16_t>((1 << WeightPrecision) - fixedTotal);
+
+        contributions.first[i] = first;
+        contributions.count[i] = count;
+    }
+
+    return contributions;
+}
+
+template <typename Pixel>
+class ResamplePlan : public Plan
+{
+public:
+    ResamplePlan(const Geometry& geometry, ResizeAlgorithm algo)
+    : columns(calculateContributions(geometry.srcWidth, geometry.dstWidth, algo))
+    , rows(calculateContributions(geometry.srcHeight, geometry.dstHeight, algo))
+    {
+    }
+
+    Range sourceRows(uint32_t begin, uint32_t end) const override
+    {
+        return { rows.first[begin], rows.first[end - 1] + rows.count[end - 1] };
+    }
+
+    Range sourceColumns(uint32_t begin, uint32_t end) const override
+    {
+        return { columns.first[begin], columns.first[end - 1] + columns.count[end - 1] };
+    }
+
+    // only the source rows that contribute to the band need to be filtered horizontally
+    // neighbouring bands filter the shared rows independently, which yields identical results
+    void runRows(const Source& src, const Target& dst, uint32_t begin, uint32_t end, const Range& columnRange) const override
+    {
+        const uint32_t intermediateStride = (columnRange.last - columnRange.first) * Pixel::size;
+        const auto range = sourceRows(begin, end);
+
+        std::vector<uint8_t> intermediate((range.last - range.first) * intermediateStride);
+        resampleHorizontal<Pixel>(src.row(range.first), src.stride, intermediate.data(), columnRange, range.last - range.first, columns);
+        resampleVertical<Pixel>(intermediate.data(), range.first, columnRange.first, intermediateStride, dst, begin, end, rows);
+    }
+
+private:
+    Contributions   columns;
+    Contributions   rows;
+};
+
+std::unique_ptr<Plan> createResamplePlan(const Geometry& geometry, uint32_t planes, uint32_t bitDepth, ResizeAlgorithm algo)
+{
+    std::unique_ptr<Plan> plan;
+    dispatchPixelType(planes, bitDepth, [&] (auto pixel) {
+        plan = std::make_unique<ResamplePlan<decltype(pixel)>>(geometry, algo);
+    });
+
+    return plan;
+}
+
+}
+}
@@ -0,0 +1,342 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "imageresize.h"
+
+#include <algorithm>
+
+#include "image/imagesimd.h"
+#include "imageparallel.h"
+
+namespace image
+{
+namespace resize
+{
+
+// 16.16 fixed point source coordinate of a destination pixel, clamped to the first source pixel
+static uint32_t sourceCoordinate(uint32_t index, uint32_t srcSize, uint32_t dstSize)
+{
+    constexpr uint64_t half = 1 << (CoordinatePrecision - 1);
+    const uint64_t coordinate = (uint64_t(index) * srcSize << CoordinatePrecision) / dstSize;
+    return static_cast<uint32_t>(coordinate > half ? coordinate - half : 0);
+}
+
+static uint8_t coordinateWeight(uint32_t coordinate)
+{
+    return static_cast<uint8_t>(coordinate >> (CoordinatePrecision - 8));
+}
+
+BilinearColumns calculateBilinearColumns(uint32_t srcWidth, uint32_t dstWidth, uint32_t pixelSize)
+{
+    BilinearColumns columns;
+    columns.left.resize(dstWidth);
+    columns.right.resize(dstWidth);
+    columns.weight.resize(dstWidth);
+
+    const uint32_t rowBytes = srcWidth * pixelSize;
+
+    for (uint32_t x = 0; x < dstWidth; ++x)
+    {
+        const uint32_t gx = sourceCoordinate(x, srcWidth, dstWidth);
+        const uint32_t left = gx >> CoordinatePrecision;
+        const uint32_t right = std::min(left + 1, srcWidth - 1);
+
+        columns.left[x] = left * pixelSize;
+        columns.right[x] = right * pixelSize;
+        columns.weight[x] = coordinateWeight(gx);
+
+        if (right * pixelSize + 4 <= rowBytes)
+        {
+            columns.safeColumns = x + 1;
+        }
+    }
+
+    return columns;
+}
+
+BilinearRows calculateBilinearRows(uint32_t srcHeight, uint32_t dstHeight)
+{
+    BilinearRows rows;
+    rows.top.resize(dstHeight);
+    rows.bottom.resize(dstHeight);
+    rows.weight.resize(dstHeight);
+
+    for (uint32_t y = 0; y < dstHeight; ++y)
+    {
+        const uint32_t gy = sourceCoordinate(y, srcHeight, dstHeight);
+        rows.top[y] = gy >> CoordinatePrecision;
+        rows.bottom[y] = std::min(rows.top[y] + 1, srcHeight - 1);
+        rows.weight[y] = coordinateWeight(gy);
+    }
+
+    return rows;
+}
+
+template <typename Pixel>
+static void bilinearRowScalar(const BilinearRow& row, const BilinearColumns& columns, uint32_t begin, uint32_t end, uint8_t* dst)
+{
+    using Sample = typename Pixel::Sample;
+
+    for (uint32_t x = begin; x < end; ++x)
+    {
+        const uint32_t weight = columns.weight[x];
+
+        const Sample* p1 = reinterpret_cast<const Sample*>(row.top + columns.left[x]);
+        const Sample* p2 = reinterpret_cast<const Sample*>(row.top + columns.right[x]);
+        const Sample* p3 = reinterpret_cast<const Sample*>(row.bottom + columns.left[x]);
+        const Sample* p4 = reinterpret_cast<const Sample*>(row.bottom + columns.right[x]);
+
+        Sample* result = reinterpret_cast<Sample*>(dst) + (x * Pixel::channels);
+        for (uint32_t i = 0; i < Pixel::channels; ++i)
+        {
+            const uint32_t top = interpolate(p1[i], p2[i], weight);
+            const uint32_t bottom = interpolate(p3[i], p4[i], weight);
+            result[i] = static_cast<Sample>(interpolate(top, bottom, row.weight));
+        }
+    }
+}
+
+static uint32_t bilinearRowNone(const BilinearRow&, const BilinearColumns&, uint32_t begin, uint32_t, uint8_t*)
+{
+    return begin;
+}
+
+template <typename Pixel>
+struct BilinearKernel
+{
+    static BilinearRowKernel select()
+    {
+        return bilinearRowNone;
+    }
+};
+
+#ifdef IMAGE_X86_SIMD
+template <uint32_t Channels>
+struct SimdBilinearKernel
+{
+    static BilinearRowKernel select()
+    {
+        switch (simdLevel())
+        {
+        case SimdLevel::Avx2:
+            return bilinearRowAvx2<Channels>;
+        case SimdLevel::Sse41:
+            return bilinearRowSse41<Channels>;
+        default:
+            return bilinearRowNone;
+        }
+    }
+};
+
+template <> struct BilinearKernel<PixelType<3, uint8_t>> : SimdBilinearKernel<3> {};
+template <> struct BilinearKernel<PixelType<4, uint8_t>> : SimdBilinearKernel<4> {};
+#endif
+
+void Plan::run(const Source& src, const Target& dst, const ResizeOptions& options) const
+{
+    forEachBand(dst.height, options, [&] (uint32_t begin, uint32_t end) {
+        runRows(src, dst, begin, end, { 0, dst.width });
+    });
+}
+
+// Number of destination rows that are converted at once by a converting plan
+constexpr uint32_t ConvertChunkRows = 16;
+
+ConvertingPlan::ConvertingPlan(std::unique_ptr<Plan> plan, uint32_t pixelSize, uint32_t convertedSize)
+: plan(std::move(plan))
+, pixelSize(pixelSize)
+, convertedSize(convertedSize)
+{
+}
+
+Range ConvertingPlan::sourceRows(uint32_t begin, uint32_t end) const
+{
+    return plan->sourceRows(begin, end);
+}
+
+Range ConvertingPlan::sourceColumns(uint32_t begin, uint32_t end) const
+{
+    return plan->sourceColumns(begin, end);
+}
+
+// only the source columns read for the destination columns are converted
+void ConvertingPlan::runRows(const Source& src, const Target& dst, uint32_t begin, uint32_t end, const Range& columnRange) const
+{
+    const auto sourceRange = plan->sourceColumns(columnRange.first, columnRange.last);
+    const uint32_t srcColumns = sourceRange.last - sourceRange.first;
+    const uint32_t dstColumns = columnRange.last - columnRange.first;
+    const uint32_t srcStride = srcColumns * convertedSize;
+    const uint32_t dstStride = dstColumns * convertedSize;
+
+    std::vector<uint8_t> sourceBuffer;
+    std::vector<uint8_t> targetBuffer(ConvertChunkRows * dstStride);
+
+    for (uint32_t chunk = begin; chunk < end; chunk += ConvertChunkRows)
+    {
+        const uint32_t chunkEnd = std::min(chunk + ConvertChunkRows, end);
+        const auto range = plan->sourceRows(chunk, chunkEnd);
+
+        sourceBuffer.resize(((range.last - range.first) * srcStride) + SourcePadding);
+        for (uint32_t y = range.first; y < range.last; ++y)
+        {
+            convertSourceRow(src.row(y) + (sourceRange.first * pixelSize), &sourceBuffer[(y - range.first) * srcStride], srcColumns);
+        }
+
+        const Source convertedSource { sourceBuffer.data(), src.width, src.height, srcStride, range.first, sourceRange.first * convertedSize };
+        const Target convertedTarget { targetBuffer.data(), dst.width, dst.height, dstStride, chunk, columnRange.first * convertedSize };
+        plan->runRows(convertedSource, convertedTarget, chunk, chunkEnd, columnRange);
+
+        for (uint32_t y = chunk; y < chunkEnd; ++y)
+        {
+            convertTargetRow(&targetBuffer[(y - chunk) * dstStride], dst.row(y) + (columnRange.first * pixelSize), dstColumns);
+        }
+    }
+}
+
+template <typename Pixel>
+class NearestNeighborPlan : public Plan
+{
+public:
+    NearestNeighborPlan(const Geometry& geometry)
+    : rows(geometry.dstHeight)
+    , columns(geometry.dstWidth)
+    {
+        const double scaleWidth   = static_cast<double>(geometry.dstWidth) / static_cast<double>(geometry.srcWidth);
+        const double scaleHeight  = static_cast<double>(geometry.dstHeight) / static_cast<double>(geometry.srcHeight);
+
+        for (uint32_t y = 0; y < geometry.dstHeight; ++y)
+        {
+            rows[y] = static_cast<uint32_t>(y / scaleHeight);
+        }
+
+        for (uint32_t x = 0; x < geometry.dstWidth; ++x)
+        {
+            columns[x] = static_cast<uint32_t>(x / scaleWidth) * Pixel::size;
+        }
+    }
+
+    Range sourceRows(uint32_t begin, uint32_t end) const override
+    {
+        return { rows[begin], rows[end - 1] + 1 };
+    }
+
+    Range sourceColumns(uint32_t begin, uint32_t end) const override
+    {
+        return { columns[begin] / Pixel::size, (columns[end - 1] / Pixel::size) + 1 };
+    }
+
+    void runRows(const Source& src, const Target& dst, uint32_t begin, uint32_t end, const Range& columnRange) const override
+    {
+        for (uint32_t y = begin; y < end; ++y)
+        {
+            const uint8_t* srcRow = src.row(rows[y]);
+            uint8_t* dstRow = dst.row(y);
+
+            for (uint32_t x = columnRange.first; x < columnRange.last; ++x)
+            {
+                const uint8_t* nearestMatch = srcRow + columns[x];
+                std::copy(nearestMatch, nearestMatch + Pixel::size, dstRow + (x * Pixel::size));
+            }
+        }
+    }
+
+private:
+    std::vector<uint32_t>   rows;       // source row of every destination row
+    std::vector<uint32_t>   columns;    // byte offset of the source pixel of every destination column
+};
+
+template <typename Pixel>
+class BilinearPlan : public Plan
+{
+public:
+    BilinearPlan(const Geometry& geometry)
+    : columns(calculateBilinearColumns(geometry.srcWidth, geometry.dstWidth, Pixel::size))
+    , rows(calculateBilinearRows(geometry.srcHeight, geometry.dstHeight))
+    {
+    }
+
+    Range sourceRows(uint32_t begin, uint32_t end) const override
+    {
+        return { rows.top[begin], rows.bottom[end - 1] + 1 };
+    }
+
+    Range sourceColumns(uint32_t begin, uint32_t end) const override
+    {
+        return { columns.left[begin] / Pixel::size, (columns.right[end - 1] / Pixel::size) + 1 };
+    }
+
+    void runRows(const Source& src, const Target& dst, uint32_t begin, uint32_t end, const Range& columnRange) const override
+    {
+        const auto kernel = BilinearKernel<Pixel>::select();
+
+        for (uint32_t y = begin; y < end; ++y)
+        {
+            BilinearRow row;
+            row.top = src.row(rows.top[y]);
+            row.bottom = src.row(rows.bottom[y]);
+            row.weight = rows.weight[y];
+
+            uint8_t* dstRow = dst.row(y);
+
+            // the kernels load 4 bytes per pixel, which reads past the end of the data on the last row
+            const uint32_t last = rows.bottom[y] == src.height - 1 ? std::min(columns.safeColumns, columnRange.last) : columnRange.last;
+            const uint32_t processed = kernel(row, columns, columnRange.first, last, dstRow);
+            bilinearRowScalar<Pixel>(row, columns, processed, columnRange.last, dstRow);
+        }
+    }
+
+private:
+    BilinearColumns     columns;
+    BilinearRows        rows;
+};
+
+std::unique_ptr<Plan> createNearestNeighborPlan(const Geometry& geometry, uint32_t planes, uint32_t bitDepth)
+{
+    std::unique_ptr<Plan> plan;
+    dispatchPixelType(planes, bitDepth, [&] (auto pixel) {
+        plan = std::make_unique<NearestNeighborPlan<decltype(pixel)>>(geometry);
+    });
+
+    return plan;
+}
+
+std::unique_ptr<Plan> createBilinearPlan(const Geometry& geometry, uint32_t planes, uint32_t bitDepth)
+{
+    std::unique_ptr<Plan> plan;
+    dispatchPixelType(planes, bitDepth, [&] (auto pixel) {
+        plan = std::make_unique<BilinearPlan<decltype(pixel)>>(geometry);
+    });
+
+    return plan;
+}
+
+std::unique_ptr<Plan> createPlan(const Geometry& geometry, uint32_t planes, uint32_t bitDepth, ResizeAlgorithm algo)
+{
+    switch (algo)
+    {
+    case ResizeAlgorithm::NearestNeighbor:
+        return createNearestNeighborPlan(geometry, planes, bitDepth);
+    case ResizeAlgorithm::Bilinear:
+        return createBilinearPlan(geometry, planes, bitDepth);
+    case ResizeAlgorithm::Area:
+        return createAreaPlan(geometry, planes, bitDepth);
+    default:
+        return createResamplePlan(geometry, planes, bitDepth, algo);
+    }
+}
+
+}
+}
@@ -0,0 +1,326 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef IMAGE_RESIZE_H
+#define IMAGE_RESIZE_H
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <cinttypes>
+
+#include "image/image.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define IMAGE_X86_SIMD 1
+#define IMAGE_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define IMAGE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace image
+{
+namespace resize
+{
+
+// Compile time description of the pixels the kernels are instantiated for
+template <uint32_t Channels, typename SampleType>
+struct PixelType
+{
+    using Sample = SampleType;
+    static constexpr uint32_t channels = Channels;
+    static constexpr uint32_t size = Channels * sizeof(SampleType);
+};
+
+// The kernel pixel type of a pixel format
+template <PixelFormat Format>
+using FormatPixelType = PixelType<Pixel<Format>::channels, typename Pixel<Format>::Sample>;
+
+// Calls func with the PixelType matching the pixel format so every format is handled by its own
+// kernel instantiation
+template <typename Func>
+void dispatchPixelType(PixelFormat format, Func&& func)
+{
+    switch (format)
+    {
+    case PixelFormat::Gray8:    return func(FormatPixelType<PixelFormat::Gray8>());
+    case PixelFormat::GrayA8:   return func(FormatPixelType<PixelFormat::GrayA8>());
+    case PixelFormat::RGB8:     return func(FormatPixelType<PixelFormat::RGB8>());
+    case PixelFormat::RGBA8:    return func(FormatPixelType<PixelFormat::RGBA8>());
+    case PixelFormat::Gray16:   return func(FormatPixelType<PixelFormat::Gray16>());
+    case PixelFormat::GrayA16:  return func(FormatPixelType<PixelFormat::GrayA16>());
+    case PixelFormat::RGB16:    return func(FormatPixelType<PixelFormat::RGB16>());
+    case PixelFormat::RGBA16:   return func(FormatPixelType<PixelFormat::RGBA16>());
+    }
+
+    throw std::runtime_error("Invalid pixel format");
+}
+
+template <typename Func>
+void dispatchPixelType(uint32_t planes, uint32_t bitDepth, Func&& func)
+{
+    dispatchPixelType(pixelFormat(planes, bitDepth), std::forward<Func>(func));
+}
+
+// Pixel memory read by a resize operation, width and height are the dimensions of the complete
+// image but the memory can start at a later row and column (when only part of the image is present)
+struct Source
+{
+    const uint8_t*  data;
+    uint32_t        width;
+    uint32_t        height;
+    uint32_t        stride;             // bytes between the start of two rows
+    uint32_t        firstRow = 0;       // row stored at the start of the data
+    uint32_t        columnOffset = 0;   // bytes of every row before the first column in the data
+
+    // the start of the complete row, only the columns present in the data can be accessed
+    const uint8_t* row(uint32_t y) const
+    {
+        return data + (size_t(y - firstRow) * stride) - columnOffset;
+    }
+};
+
+// Pixel memory written by a resize operation
+struct Target
+{
+    uint8_t*        data;
+    uint32_t        width;
+    uint32_t        height;
+    uint32_t        stride;             // bytes between the start of two rows
+    uint32_t        firstRow = 0;       // row stored at the start of the data
+    uint32_t        columnOffset = 0;   // bytes of every row before the first column in the data
+
+    uint8_t* row(uint32_t y) const
+    {
+        return data + (size_t(y - firstRow) * stride) - columnOffset;
+    }
+};
+
+// Fixed point precision of the bilinear source coordinates (16.16)
+constexpr uint32_t CoordinatePrecision = 16;
+
+// Source offsets and 8-bit weights of every destination column, calculated once per resize
+struct BilinearColumns
+{
+    std::vector<uint32_t>   left;       // byte offset of the left source pixel
+    std::vector<uint32_t>   right;      // byte offset of the right source pixel
+    std::vector<uint8_t>    weight;     // weight of the right source pixel (out of 256)
+
+    // number of leading columns for which a 4 byte load at the right offset stays within a row
+    uint32_t                safeColumns = 0;
+};
+
+// Source rows and 8-bit weights of every destination row, calculated once per resize
+struct BilinearRows
+{
+    std::vector<uint32_t>   top;
+    std::vector<uint32_t>   bottom;
+    std::vector<uint8_t>    weight;     // weight of the bottom source row (out of 256)
+};
+
+// The two source rows contributing to a destination row
+struct BilinearRow
+{
+    const uint8_t*  top;
+    const uint8_t*  bottom;
+    uint32_t        weight;
+};
+
+BilinearColumns calculateBilinearColumns(uint32_t srcWidth, uint32_t dstWidth, uint32_t pixelSize);
+BilinearRows calculateBilinearRows(uint32_t srcHeight, uint32_t dstHeight);
+
+// Every pixel is interpolated horizontally and then vertically, rounding after each step.
+// The scalar and vectorized implementations produce identical results.
+inline uint32_t interpolate(uint32_t a, uint32_t b, uint32_t weight)
+{
+    return (a * (256 - weight) + b * weight + 128) >> 8;
+}
+
+// Vectorized row kernels process the leading columns of the destination columns [begin, end) and
+// return the first column they did not handle, the remaining columns are processed by the scalar
+// implementation.
+// The kernels are instantiated for 8-bit pixels with 3 and 4 channels.
+using BilinearRowKernel = uint32_t (*)(const BilinearRow& row, const BilinearColumns& columns, uint32_t begin, uint32_t end, uint8_t* dst);
+
+#ifdef IMAGE_X86_SIMD
+template <uint32_t Channels>
+IMAGE_TARGET_SSE41 uint32_t bilinearRowSse41(const BilinearRow& row, const BilinearColumns& columns, uint32_t begin, uint32_t end, uint8_t* dst);
+template <uint32_t Channels>
+IMAGE_TARGET_AVX2 uint32_t bilinearRowAvx2(const BilinearRow& row, const BilinearColumns& columns, uint32_t begin, uint32_t end, uint8_t* dst);
+#endif
+
+// Exact 2x, 4x and 8x reductions average blocks of Factor x Factor source pixels:
+// (sum + (Factor * Factor) / 2) / (Factor * Factor), which is identical to the area averaging result.
+// The row kernels are given the Factor source rows of a destination row, process the leading
+// columns and return the number of columns they handled, the remaining columns are processed by
+// the scalar implementation.
+// The kernels are instantiated for 8-bit pixels with 3 and 4 channels.
+using BoxRowKernel = uint32_t (*)(const uint8_t* const* rows, uint32_t count, uint8_t* dst);
+
+#ifdef IMAGE_X86_SIMD
+template <uint32_t Channels, uint32_t Factor>
+IMAGE_TARGET_SSE41 uint32_t boxRowSse41(const uint8_t* const* rows, uint32_t count, uint8_t* dst);
+template <uint32_t Channels, uint32_t Factor>
+IMAGE_TARGET_AVX2 uint32_t boxRowAvx2(const uint8_t* const* rows, uint32_t count, uint8_t* dst);
+#endif
+
+// Premultiplied 8-bit colors are round(color * alpha / 255), they are unpremultiplied with a table
+// of 16.16 fixed point reciprocals of the alpha values
+const uint32_t* alphaReciprocals();
+
+inline uint8_t premultiply(uint8_t color, uint8_t alpha)
+{
+    const uint32_t value = (color * alpha) + 128;
+    return static_cast<uint8_t>((value + (value >> 8)) >> 8);
+}
+
+inline uint8_t unpremultiply(uint8_t color, uint8_t alpha, const uint32_t* reciprocals)
+{
+    return static_cast<uint8_t>(std::min<uint32_t>(255, ((color * reciprocals[alpha]) + 32768) >> 16));
+}
+
+inline uint16_t premultiply(uint16_t color, uint16_t alpha)
+{
+    return static_cast<uint16_t>(((uint32_t(color) * alpha) + 32767) / 65535);
+}
+
+inline uint16_t unpremultiply(uint16_t color, uint16_t alpha, const uint32_t*)
+{
+    return alpha == 0 ? 0 : static_cast<uint16_t>(std::min<uint32_t>(65535, ((uint32_t(color) * 65535) + (alpha / 2)) / alpha));
+}
+
+// The alpha row kernels convert the leading pixels of a row and return the number of pixels they
+// handled, the remaining pixels are converted by the scalar implementation.
+// The kernels are implemented for 8-bit RGBA pixels.
+using AlphaRowKernel = uint32_t (*)(const uint8_t* src, uint8_t* dst, uint32_t count);
+
+#ifdef IMAGE_X86_SIMD
+IMAGE_TARGET_SSE41 uint32_t premultiplyRowSse41(const uint8_t* src, uint8_t* dst, uint32_t count);
+IMAGE_TARGET_SSE41 uint32_t unpremultiplyRowSse41(const uint8_t* src, uint8_t* dst, uint32_t count);
+IMAGE_TARGET_AVX2 uint32_t premultiplyRowAvx2(const uint8_t* src, uint8_t* dst, uint32_t count);
+IMAGE_TARGET_AVX2 uint32_t unpremultiplyRowAvx2(const uint8_t* src, uint8_t* dst, uint32_t count);
+#endif
+
+// Fixed point precision of the separable filter weights
+constexpr int32_t WeightPrecision = 14;
+
+// Source pixels contributing to every destination pixel of a separable filter pass
+struct Contributions
+{
+    uint32_t                taps = 0;   // maximum number of contributing source pixels
+    std::vector<uint32_t>   first;      // first contributing source pixel
+    std::vector<uint32_t>   count;      // number of contributing source pixels
+    std::vector<int16_t>    weights;    // taps weights per destination pixel
+};
+
+Contributions calculateContributions(uint32_t srcSize, uint32_t dstSize, ResizeAlgorithm algo);
+
+// Dimensions of a resize operation
+struct Geometry
+{
+    uint32_t    srcWidth;
+    uint32_t    srcHeight;
+    uint32_t    dstWidth;
+    uint32_t    dstHeight;
+};
+
+constexpr uint32_t SourcePadding = 16;
+
+// Source or destination pixels [first, last) along one axis
+struct Range
+{
+    uint32_t    first;
+    uint32_t    last;
+};
+
+// A resize of a fixed geometry and pixel type, the coordinate and weight tables are calculated
+// on construction and are not modified while resizing, so a plan can be used by multiple threads.
+class Plan
+{
+public:
+    virtual ~Plan() = default;
+
+    // The destination rows are processed in bands as configured in the options, every band
+    // produces exactly the same output as a single threaded resize would.
+    // The source and target dimensions must match the geometry of the plan.
+    void run(const Source& src, const Target& dst, const ResizeOptions& options) const;
+
+    // The source rows that are read to produce the destination rows [begin, end)
+    virtual Range sourceRows(uint32_t begin, uint32_t end) const = 0;
+
+    // The source columns that are read to produce the destination columns [begin, end)
+    virtual Range sourceColumns(uint32_t begin, uint32_t end) const = 0;
+
+    // Produces the destination columns of the rows [begin, end), only the source rows and columns
+    // returned by sourceRows and sourceColumns have to be present in the source, every pixel is
+    // identical to the result of resizing complete rows. The kernels only avoid reading past the end
+    // of the last row of the image, a source holding part of the image needs SourcePadding bytes
+    // after its last row.
+    virtual void runRows(const Source& src, const Target& dst, uint32_t begin, uint32_t end, const Range& columnRange) const = 0;
+};
+
+// Resizes converted samples using another plan: the source rows of every chunk of destination rows
+// are converted right before they are resized and the resized rows are converted back while they
+// are still cached, so the image is processed in a single pass without a converted copy.
+class ConvertingPlan : public Plan
+{
+public:
+    Range sourceRows(uint32_t begin, uint32_t end) const override;
+    Range sourceColumns(uint32_t begin, uint32_t end) const override;
+    void runRows(const Source& src, const Target& dst, uint32_t begin, uint32_t end, const Range& columnRange) const override;
+
+protected:
+    // the plan resizes the converted pixels of convertedSize bytes, the pixels of the source
+    // and target are pixelSize bytes
+    ConvertingPlan(std::unique_ptr<Plan> plan, uint32_t pixelSize, uint32_t convertedSize);
+
+    virtual void convertSourceRow(const uint8_t* src, uint8_t* dst, uint32_t width) const = 0;
+    virtual void convertTargetRow(const uint8_t* src, uint8_t* dst, uint32_t width) const = 0;
+
+private:
+    std::unique_ptr<Plan>   plan;
+    uint32_t                pixelSize;
+    uint32_t                convertedSize;
+};
+
+std::unique_ptr<Plan> createPlan(const Geometry& geometry, uint32_t planes, uint32_t bitDepth, ResizeAlgorithm algo);
+
+std::unique_ptr<Plan> createNearestNeighborPlan(const Geometry& geometry, uint32_t planes, uint32_t bitDepth);
+std::unique_ptr<Plan> createBilinearPlan(const Geometry& geometry, uint32_t planes, uint32_t bitDepth);
+
+// Exact area averaging, every source pixel is read once and accumulated in integer row accumulators
+std::unique_ptr<Plan> createAreaPlan(const Geometry& geometry, uint32_t planes, uint32_t bitDepth);
+
+// Averages the 2x2 blocks of the two source rows into (srcWidth + 1) / 2 destination pixels with
+// the 2x box kernels, the last column of an odd width is averaged with itself
+using HalveRowFunction = void (*)(const uint8_t* const* rows, uint32_t srcWidth, uint8_t* dst);
+HalveRowFunction selectHalveRow(uint32_t planes, uint32_t bitDepth);
+
+// Two pass (horizontal then vertical) resampling using the filter of the provided algorithm
+std::unique_ptr<Plan> createResamplePlan(const Geometry& geometry, uint32_t planes, uint32_t bitDepth, ResizeAlgorithm algo);
+
+// Filters the color channels of images with an alpha channel premultiplied with the alpha value
+std::unique_ptr<Plan> createPremultipliedPlan(const Geometry& geometry, uint32_t planes, uint32_t bitDepth, ResizeAlgorithm algo);
+
+// Resizes 8-bit sRGB images in linear light: the samples are converted to 16-bit linear values,
+// resized by the 16-bit plan of the algorithm and converted back to sRGB using lookup tables
+std::unique_ptr<Plan> createLinearLightPlan(const Geometry& geometry, uint32_t planes, ResizeAlgorithm algo, bool premultiplied);
+
+}
+}
+
+#endif
@@ -0,0 +1,187 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "imageresize.h"
+
+#include "image/imagesimd.h"
+
+namespace image
+{
+namespace resize
+{
+
+namespace
+{
+
+struct AlphaReciprocals
+{
+    AlphaReciprocals()
+    {
+        // a transparent pixel has no color
+        values[0] = 0;
+        for (uint32_t alpha = 1; alpha < 256; ++alpha)
+        {
+            values[alpha] = ((255u << 16) + (alpha / 2)) / alpha;
+        }
+    }
+
+    uint32_t values[256];
+};
+
+// the alpha channel is the last plane and is not modified
+template <typename Pixel>
+void premultiplyRowScalar(const uint8_t* src, uint8_t* dst, uint32_t begin, uint32_t end)
+{
+    using Sample = typename Pixel::Sample;
+    constexpr uint32_t alpha = Pixel::channels - 1;
+
+    for (uint32_t x = begin; x < end; ++x)
+    {
+        const Sample* pixel = reinterpret_cast<const Sample*>(src) + (x * Pixel::channels);
+        Sample* result = reinterpret_cast<Sample*>(dst) + (x * Pixel::channels);
+
+        for (uint32_t i = 0; i < alpha; ++i)
+        {
+            result[i] = premultiply(pixel[i], pixel[alpha]);
+        }
+
+        result[alpha] = pixel[alpha];
+    }
+}
+
+template <typename Pixel>
+void unpremultiplyRowScalar(const uint8_t* src, uint8_t* dst, uint32_t begin, uint32_t end, const uint32_t* reciprocals)
+{
+    using Sample = typename Pixel::Sample;
+    constexpr uint32_t alpha = Pixel::channels - 1;
+
+    for (uint32_t x = begin; x < end; ++x)
+    {
+        const Sample* pixel = reinterpret_cast<const Sample*>(src) + (x * Pixel::channels);
+        Sample* result = reinterpret_cast<Sample*>(dst) + (x * Pixel::channels);
+
+        for (uint32_t i = 0; i < alpha; ++i)
+        {
+            result[i] = unpremultiply(pixel[i], pixel[alpha], reciprocals);
+        }
+
+        result[alpha] = pixel[alpha];
+    }
+}
+
+uint32_t alphaRowNone(const uint8_t*, uint8_t*, uint32_t)
+{
+    return 0;
+}
+
+template <typename Pixel>
+struct AlphaKernels
+{
+    static AlphaRowKernel premultiply()
+    {
+        return alphaRowNone;
+    }
+
+    static AlphaRowKernel unpremultiply()
+    {
+        return alphaRowNone;
+    }
+};
+
+#ifdef IMAGE_X86_SIMD
+template <>
+struct AlphaKernels<PixelType<4, uint8_t>>
+{
+    static AlphaRowKernel premultiply()
+    {
+        switch (simdLevel())
+        {
+        case SimdLevel::Avx2:
+            return premultiplyRowAvx2;
+        case SimdLevel::Sse41:
+            return premultiplyRowSse41;
+        default:
+            return alphaRowNone;
+        }
+    }
+
+    static AlphaRowKernel unpremultiply()
+    {
+        switch (simdLevel())
+        {
+        case SimdLevel::Avx2:
+            return unpremultiplyRowAvx2;
+        case SimdLevel::Sse41:
+            return unpremultiplyRowSse41;
+        default:
+            return alphaRowNone;
+        }
+    }
+};
+#endif
+
+template <typename Pixel>
+class PremultipliedPlan : public ConvertingPlan
+{
+public:
+    PremultipliedPlan(const Geometry& geometry, ResizeAlgorithm algo)
+    : ConvertingPlan(createPlan(geometry, Pixel::channels, sizeof(typename Pixel::Sample) * 8, algo), Pixel::size, Pixel::size)
+    , reciprocals(alphaReciprocals())
+    {
+    }
+
+protected:
+    void convertSourceRow(const uint8_t* src, uint8_t* dst, uint32_t width) const override
+    {
+        const uint32_t processed = AlphaKernels<Pixel>::premultiply()(src, dst, width);
+        premultiplyRowScalar<Pixel>(src, dst, processed, width);
+    }
+
+    void convertTargetRow(const uint8_t* src, uint8_t* dst, uint32_t width) const override
+    {
+        const uint32_t processed = AlphaKernels<Pixel>::unpremultiply()(src, dst, width);
+        unpremultiplyRowScalar<Pixel>(src, dst, processed, width, reciprocals);
+    }
+
+private:
+    const uint32_t* reciprocals;
+};
+
+}
+
+const uint32_t* alphaReciprocals()
+{
+    static const AlphaReciprocals reciprocals;
+    return reciprocals.values;
+}
+
+std::unique_ptr<Plan> createPremultipliedPlan(const Geometry& geometry, uint32_t planes, uint32_t bitDepth, ResizeAlgorithm algo)
+{
+    // nearest neighbor does not blend pixels, so premultiplying does not change the result
+    if (algo != ResizeAlgorithm::NearestNeighbor)
+    {
+        if (bitDepth == 8 && planes == 2) return std::make_unique<PremultipliedPlan<PixelType<2, uint8_t>>>(geometry, algo);
+        if (bitDepth == 8 && planes == 4) return std::make_unique<PremultipliedPlan<PixelType<4, uint8_t>>>(geometry, algo);
+        if (bitDepth == 16 && planes == 2) return std::make_unique<PremultipliedPlan<PixelType<2, uint16_t>>>(geometry, algo);
+        if (bitDepth == 16 && planes == 4) return std::make_unique<PremultipliedPlan<PixelType<4, uint16_t>>>(geometry, algo);
+    }
+
+    // images without an alpha channel
+    return createPlan(geometry, planes, bitDepth, algo);
+}
+
+}
+}
@@ -0,0 +1,346 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "imageresize.h"
+
+#include <algorithm>
+#include <type_traits>
+
+#include "image/imagesimd.h"
+
+namespace image
+{
+namespace resize
+{
+
+namespace
+{
+
+// Area coverage of the source pixels along one axis: a source pixel spans dstSize units and a
+// destination pixel srcSize units, so every source pixel contributes to at most two destination
+// pixels and the weights are exact integers
+struct AreaAxis
+{
+    std::vector<uint32_t>   index;      // first destination pixel covered by the source pixel
+    std::vector<uint32_t>   weight;     // coverage of the first destination pixel, the remainder goes to the next one
+};
+
+AreaAxis calculateAreaAxis(uint32_t srcSize, uint32_t dstSize)
+{
+    AreaAxis axis;
+    axis.index.resize(srcSize);
+    axis.weight.resize(srcSize);
+
+    for (uint32_t i = 0; i < srcSize; ++i)
+    {
+        const uint64_t start = uint64_t(i) * dstSize;
+        const uint64_t end = start + dstSize;
+        const uint64_t index = start / srcSize;
+        const uint64_t boundary = (index + 1) * srcSize;
+
+        axis.index[i] = static_cast<uint32_t>(index);
+        axis.weight[i] = static_cast<uint32_t>(end <= boundary ? dstSize : boundary - start);
+    }
+
+    return axis;
+}
+
+// the source pixels covering the destination pixels [begin, end), every source pixel is read exactly once
+Range coveringPixels(uint32_t begin, uint32_t end, uint32_t srcSize, uint32_t dstSize)
+{
+    const uint64_t first = (uint64_t(begin) * srcSize) / dstSize;
+    const uint64_t last = std::min<uint64_t>(((uint64_t(end) * srcSize) + dstSize - 1) / dstSize, srcSize);
+    return { static_cast<uint32_t>(first), static_cast<uint32_t>(last) };
+}
+
+template <typename Pixel, uint32_t Factor>
+void boxRowScalar(const uint8_t* const* rows, uint32_t begin, uint32_t end, uint8_t* dst)
+{
+    using Sample = typename Pixel::Sample;
+    constexpr uint32_t blockSize = Factor * Factor;
+
+    for (uint32_t x = begin; x < end; ++x)
+    {
+        Sample* result = reinterpret_cast<Sample*>(dst) + (x * Pixel::channels);
+        for (uint32_t i = 0; i < Pixel::channels; ++i)
+        {
+            uint32_t sum = 0;
+            for (uint32_t row = 0; row < Factor; ++row)
+            {
+                const Sample* block = reinterpret_cast<const Sample*>(rows[row]) + (x * Factor * Pixel::channels);
+                for (uint32_t j = 0; j < Factor; ++j)
+                {
+                    sum += block[(j * Pixel::channels) + i];
+                }
+            }
+
+            result[i] = static_cast<Sample>((sum + (blockSize / 2)) / blockSize);
+        }
+    }
+}
+
+uint32_t boxRowNone(const uint8_t* const*, uint32_t, uint8_t*)
+{
+    return 0;
+}
+
+template <typename Pixel, uint32_t Factor>
+struct BoxKernel
+{
+    static BoxRowKernel select()
+    {
+        return boxRowNone;
+    }
+};
+
+#ifdef IMAGE_X86_SIMD
+template <uint32_t Channels, uint32_t Factor>
+struct SimdBoxKernel
+{
+    static BoxRowKernel select()
+    {
+        switch (simdLevel())
+        {
+        case SimdLevel::Avx2:
+            return boxRowAvx2<Channels, Factor>;
+        case SimdLevel::Sse41:
+            return boxRowSse41<Channels, Factor>;
+        default:
+            return boxRowNone;
+        }
+    }
+};
+
+template <uint32_t Factor> struct BoxKernel<PixelType<3, uint8_t>, Factor> : SimdBoxKernel<3, Factor> {};
+template <uint32_t Factor> struct BoxKernel<PixelType<4, uint8_t>, Factor> : SimdBoxKernel<4, Factor> {};
+#endif
+
+template <typename Pixel>
+void halveRow(const uint8_t* const* rows, uint32_t srcWidth, uint8_t* dst)
+{
+    using Sample = typename Pixel::Sample;
+
+    const uint32_t blocks = srcWidth / 2;
+    const uint32_t processed = BoxKernel<Pixel, 2>::select()(rows, blocks, dst);
+    boxRowScalar<Pixel, 2>(rows, processed, blocks, dst);
+
+    if (srcWidth % 2)
+    {
+        const Sample* top = reinterpret_cast<const Sample*>(rows[0]) + (blocks * 2 * Pixel::channels);
+        const Sample* bottom = reinterpret_cast<const Sample*>(rows[1]) + (blocks * 2 * Pixel::channels);
+        Sample* result = reinterpret_cast<Sample*>(dst) + (blocks * Pixel::channels);
+        for (uint32_t i = 0; i < Pixel::channels; ++i)
+        {
+            result[i] = static_cast<Sample>((uint32_t(top[i]) + bottom[i] + 1) / 2);
+        }
+    }
+}
+
+bool isBoxReduction(const Geometry& geometry, uint32_t factor)
+{
+    return geometry.srcWidth == geometry.dstWidth * factor && geometry.srcHeight == geometry.dstHeight * factor;
+}
+
+// Exact 2x, 4x and 8x reductions, every destination pixel is the average of a block of source pixels
+// without any coordinate tables
+template <typename Pixel, uint32_t Factor>
+class BoxPlan : public Plan
+{
+public:
+    Range sourceRows(uint32_t begin, uint32_t end) const override
+    {
+        return { begin * Factor, end * Factor };
+    }
+
+    Range sourceColumns(uint32_t begin, uint32_t end) const override
+    {
+        return { begin * Factor, end * Factor };
+    }
+
+    void runRows(const Source& src, const Target& dst, uint32_t begin, uint32_t end, const Range& columnRange) const override
+    {
+        const auto kernel = BoxKernel<Pixel, Factor>::select();
+        const uint32_t count = columnRange.last - columnRange.first;
+
+        for (uint32_t y = begin; y < end; ++y)
+        {
+            // the kernels process the blocks relative to the first destination column
+            const uint8_t* rows[Factor];
+            for (uint32_t i = 0; i < Factor; ++i)
+            {
+                rows[i] = src.row((y * Factor) + i) + (columnRange.first * Factor * Pixel::size);
+            }
+
+            uint8_t* dstRow = dst.row(y) + (columnRange.first * Pixel::size);
+            const uint32_t processed = kernel(rows, count, dstRow);
+            boxRowScalar<Pixel, Factor>(rows, processed, count, dstRow);
+        }
+    }
+};
+
+template <typename Pixel>
+class AreaPlan : public Plan
+{
+public:
+    AreaPlan(const Geometry& geometry)
+    : geometry(geometry)
+    , columns(calculateAreaAxis(geometry.srcWidth, geometry.dstWidth))
+    , rows(calculateAreaAxis(geometry.srcHeight, geometry.dstHeight))
+    {
+    }
+
+    Range sourceRows(uint32_t begin, uint32_t end) const override
+    {
+        return coveringPixels(begin, end, geometry.srcHeight, geometry.dstHeight);
+    }
+
+    Range sourceColumns(uint32_t begin, uint32_t end) const override
+    {
+        return coveringPixels(begin, end, geometry.srcWidth, geometry.dstWidth);
+    }
+
+    void runRows(const Source& src, const Target& dst, uint32_t begin, uint32_t end, const Range& columnRange) const override;
+
+private:
+    Geometry    geometry;
+    AreaAxis    columns;
+    AreaAxis    rows;
+};
+
+template <typename Pixel>
+void AreaPlan<Pixel>::runRows(const Source& src, const Target& dst, uint32_t begin, uint32_t end, const Range& columnRange) const
+{
+    using Sample = typename Pixel::Sample;
+    using RowSum = typename std::conditional<sizeof(Sample) == 1, uint32_t, uint64_t>::type;
+
+    const uint32_t samples = (columnRange.last - columnRange.first) * Pixel::channels;
+    const uint64_t total = uint64_t(src.width) * src.height;
+
+    // the horizontal sums get one pixel of padding on both sides for the parts of the first and
+    // last source column that cover the neighbouring destination columns
+    std::vector<RowSum> rowSums(samples + (2 * Pixel::channels));
+    std::vector<uint64_t> accumulators[2] = { std::vector<uint64_t>(samples), std::vector<uint64_t>(samples) };
+    uint32_t current = begin;
+
+    auto emitRow = [&] () {
+        Sample* dstRow = reinterpret_cast<Sample*>(dst.row(current) + (columnRange.first * Pixel::size));
+        for (uint32_t i = 0; i < samples; ++i)
+        {
+            dstRow[i] = static_cast<Sample>((accumulators[0][i] + (total / 2)) / total);
+        }
+
+        std::swap(accumulators[0], accumulators[1]);
+        std::fill(accumulators[1].begin(), accumulators[1].end(), 0);
+        ++current;
+    };
+
+    auto accumulate = [&] (uint32_t row, uint64_t weight) {
+        if (weight == 0 || row < begin || row >= end)
+        {
+            return;
+        }
+
+        auto& accumulator = accumulators[row - current];
+        for (uint32_t i = 0; i < samples; ++i)
+        {
+            accumulator[i] += rowSums[Pixel::channels + i] * weight;
+        }
+    };
+
+    const auto range = sourceRows(begin, end);
+    const auto sourceRange = sourceColumns(columnRange.first, columnRange.last);
+    for (uint32_t y = range.first; y < range.last; ++y)
+    {
+        const Sample* srcRow = reinterpret_cast<const Sample*>(src.row(y));
+        std::fill(rowSums.begin(), rowSums.end(), 0);
+
+        for (uint32_t x = sourceRange.first; x < sourceRange.last; ++x)
+        {
+            const Sample* pixel = srcRow + (x * Pixel::channels);
+            RowSum* sums = &rowSums[(columns.index[x] + 1 - columnRange.first) * Pixel::channels];
+            const RowSum weight = columns.weight[x];
+            const RowSum remainder = dst.width - weight;
+
+            for (uint32_t i = 0; i < Pixel::channels; ++i)
+            {
+                sums[i] += pixel[i] * weight;
+                sums[i + Pixel::channels] += pixel[i] * remainder;
+            }
+        }
+
+        const uint32_t dstRow = rows.index[y];
+        while (current < dstRow && current < end)
+        {
+            emitRow();
+        }
+
+        accumulate(dstRow, rows.weight[y]);
+        accumulate(dstRow + 1, dst.height - rows.weight[y]);
+    }
+
+    while (current < end)
+    {
+        emitRow();
+    }
+}
+
+}
+
+std::unique_ptr<Plan> createAreaPlan(const Geometry& geometry, uint32_t planes, uint32_t bitDepth)
+{
+    if (geometry.dstWidth > geometry.srcWidth || geometry.dstHeight > geometry.srcHeight)
+    {
+        // area averaging is only defined for reductions
+        return createBilinearPlan(geometry, planes, bitDepth);
+    }
+
+    std::unique_ptr<Plan> plan;
+    dispatchPixelType(planes, bitDepth, [&] (auto pixel) {
+        using Pixel = decltype(pixel);
+
+        if (isBoxReduction(geometry, 2))
+        {
+            plan = std::make_unique<BoxPlan<Pixel, 2>>();
+        }
+        else if (isBoxReduction(geometry, 4))
+        {
+            plan = std::make_unique<BoxPlan<Pixel, 4>>();
+        }
+        else if (isBoxReduction(geometry, 8))
+        {
+            plan = std::make_unique<BoxPlan<Pixel, 8>>();
+        }
+        else
+        {
+            plan = std::make_unique<AreaPlan<Pixel>>(geometry);
+        }
+    });
+
+    return plan;
+}
+
+HalveRowFunction selectHalveRow(uint32_t planes, uint32_t bitDepth)
+{
+    HalveRowFunction function = nullptr;
+    dispatchPixelType(planes, bitDepth, [&] (auto pixel) {
+        function = halveRow<decltype(pixel)>;
+    });
+
+    return function;
+}
+
+}
+}
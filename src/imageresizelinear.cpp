@@ -0,0 +1,242 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "imageresize.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace image
+{
+namespace resize
+{
+
+namespace
+{
+
+// The sRGB table is indexed by the 13 most significant bits of a linear value, which is precise
+// enough to convert every sRGB value to linear and back without changing it
+constexpr uint32_t LinearIndexShift = 3;
+
+struct LinearLightTables
+{
+    LinearLightTables()
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            const double value = i / 255.0;
+            const double linear = value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+            toLinear[i] = static_cast<uint16_t>(std::lround(linear * 65535.0));
+        }
+
+        constexpr double center = ((1 << LinearIndexShift) - 1) / 2.0;
+        for (uint32_t i = 0; i < (65536 >> LinearIndexShift); ++i)
+        {
+            const double linear = ((i << LinearIndexShift) + center) / 65535.0;
+            const double value = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+            toSrgb[i] = static_cast<uint8_t>(std::lround(std::min(value, 1.0) * 255.0));
+        }
+    }
+
+    uint16_t    toLinear[256];
+    uint8_t     toSrgb[65536 >> LinearIndexShift];
+};
+
+const LinearLightTables& linearLightTables()
+{
+    static const LinearLightTables tables;
+    return tables;
+}
+
+// the last plane of gray + alpha and RGBA images is the alpha channel, which is not gamma encoded
+template <uint32_t Planes>
+struct ColorPlanes
+{
+    static constexpr uint32_t value = (Planes == 2 || Planes == 4) ? Planes - 1 : Planes;
+};
+
+// Bilinear interpolation only reads 4 source pixels per destination pixel, so the samples are
+// converted while interpolating instead of converting the complete image
+template <uint32_t Planes>
+class LinearLightBilinearPlan : public Plan
+{
+public:
+    LinearLightBilinearPlan(const Geometry& geometry)
+    : columns(calculateBilinearColumns(geometry.srcWidth, geometry.dstWidth, Planes))
+    , rows(calculateBilinearRows(geometry.srcHeight, geometry.dstHeight))
+    , tables(linearLightTables())
+    {
+    }
+
+    Range sourceRows(uint32_t begin, uint32_t end) const override
+    {
+        return { rows.top[begin], rows.bottom[end - 1] + 1 };
+    }
+
+    Range sourceColumns(uint32_t begin, uint32_t end) const override
+    {
+        return { columns.left[begin] / Planes, (columns.right[end - 1] / Planes) + 1 };
+    }
+
+    void runRows(const Source& src, const Target& dst, uint32_t begin, uint32_t end, const Range& columnRange) const override
+    {
+        for (uint32_t y = begin; y < end; ++y)
+        {
+            const uint8_t* top = src.row(rows.top[y]);
+            const uint8_t* bottom = src.row(rows.bottom[y]);
+            const uint32_t weight = rows.weight[y];
+            uint8_t* dstRow = dst.row(y);
+
+            for (uint32_t x = columnRange.first; x < columnRange.last; ++x)
+            {
+                const uint8_t* p1 = top + columns.left[x];
+                const uint8_t* p2 = top + columns.right[x];
+                const uint8_t* p3 = bottom + columns.left[x];
+                const uint8_t* p4 = bottom + columns.right[x];
+                uint8_t* result = dstRow + (x * Planes);
+
+                for (uint32_t i = 0; i < ColorPlanes<Planes>::value; ++i)
+                {
+                    const uint32_t t = interpolate(tables.toLinear[p1[i]], tables.toLinear[p2[i]], columns.weight[x]);
+                    const uint32_t b = interpolate(tables.toLinear[p3[i]], tables.toLinear[p4[i]], columns.weight[x]);
+                    result[i] = tables.toSrgb[interpolate(t, b, weight) >> LinearIndexShift];
+                }
+
+                for (uint32_t i = ColorPlanes<Planes>::value; i < Planes; ++i)
+                {
+                    const uint32_t t = interpolate(p1[i], p2[i], columns.weight[x]);
+                    const uint32_t b = interpolate(p3[i], p4[i], columns.weight[x]);
+                    result[i] = static_cast<uint8_t>(interpolate(t, b, weight));
+                }
+            }
+        }
+    }
+
+private:
+    BilinearColumns             columns;
+    BilinearRows                rows;
+    const LinearLightTables&    tables;
+};
+
+// The other algorithms convert the samples to 16-bit linear values, resize them with the 16-bit
+// implementation of the algorithm and convert the result back. The alpha channel is scaled to
+// 16-bit without gamma conversion, premultiplying is done on the linear values.
+template <uint32_t Planes, bool Premultiplied>
+class LinearLightPlan : public ConvertingPlan
+{
+public:
+    LinearLightPlan(const Geometry& geometry, ResizeAlgorithm algo)
+    : ConvertingPlan(createPlan(geometry, Planes, 16, algo), Planes, Planes * sizeof(uint16_t))
+    , tables(linearLightTables())
+    {
+    }
+
+protected:
+    void convertSourceRow(const uint8_t* src, uint8_t* dst, uint32_t width) const override
+    {
+        auto* linear = reinterpret_cast<uint16_t*>(dst);
+
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            for (uint32_t i = colorPlanes; i < Planes; ++i)
+            {
+                linear[i] = static_cast<uint16_t>(src[i] * 257);
+            }
+
+            for (uint32_t i = 0; i < colorPlanes; ++i)
+            {
+                linear[i] = tables.toLinear[src[i]];
+                if (Premultiplied)
+                {
+                    linear[i] = premultiply(linear[i], linear[colorPlanes]);
+                }
+            }
+
+            src += Planes;
+            linear += Planes;
+        }
+    }
+
+    void convertTargetRow(const uint8_t* src, uint8_t* dst, uint32_t width) const override
+    {
+        const auto* linear = reinterpret_cast<const uint16_t*>(src);
+
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            for (uint32_t i = 0; i < colorPlanes; ++i)
+            {
+                const uint16_t value = Premultiplied ? unpremultiply(linear[i], linear[colorPlanes], nullptr) : linear[i];
+                dst[i] = tables.toSrgb[value >> LinearIndexShift];
+            }
+
+            for (uint32_t i = colorPlanes; i < Planes; ++i)
+            {
+                dst[i] = static_cast<uint8_t>((linear[i] + 128) / 257);
+            }
+
+            linear += Planes;
+            dst += Planes;
+        }
+    }
+
+private:
+    static constexpr uint32_t colorPlanes = ColorPlanes<Planes>::value;
+
+    const LinearLightTables&    tables;
+};
+
+template <uint32_t Planes>
+std::unique_ptr<Plan> createLinearLightPlan(const Geometry& geometry, ResizeAlgorithm algo, bool premultiplied)
+{
+    if (algo == ResizeAlgorithm::NearestNeighbor)
+    {
+        // the samples are copied, so the color space does not matter
+        return createNearestNeighborPlan(geometry, Planes, 8);
+    }
+
+    // premultiplying only affects images with an alpha channel
+    if (premultiplied && ColorPlanes<Planes>::value != Planes)
+    {
+        return std::make_unique<LinearLightPlan<Planes, true>>(geometry, algo);
+    }
+
+    // enlarging with the area algorithm falls back to bilinear, like the encoded area plan
+    const bool enlarging = geometry.dstWidth > geometry.srcWidth || geometry.dstHeight > geometry.srcHeight;
+    if (algo == ResizeAlgorithm::Bilinear || (algo == ResizeAlgorithm::Area && enlarging))
+    {
+        return std::make_unique<LinearLightBilinearPlan<Planes>>(geometry);
+    }
+
+    return std::make_unique<LinearLightPlan<Planes, false>>(geometry, algo);
+}
+
+}
+
+std::unique_ptr<Plan> createLinearLightPlan(const Geometry& geometry, uint32_t planes, ResizeAlgorithm algo, bool premultiplied)
+{
+    switch (planes)
+    {
+    case 1: return createLinearLightPlan<1>(geometry, algo, premultiplied);
+    case 2: return createLinearLightPlan<2>(geometry, algo, premultiplied);
+    case 3: return createLinearLightPlan<3>(geometry, algo, premultiplied);
+    case 4: return createLinearLightPlan<4>(geometry, algo, premultiplied);
+    default:
+        throw std::runtime_error("Resizing is only supported for images with 1 to 4 color planes");
+    }
+}
+
+}
+}
@@ -0,0 +1,187 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "image/imageresizeplan.h"
+
+#include "imageresize.h"
+#include "imageparallel.h"
+
+namespace image
+{
+
+ResizePlan::ResizePlan(uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight, ResizeAlgorithm algo, uint32_t colorPlanes, uint32_t bitDepth, bool linearLight, bool premultiplyAlpha)
+: srcWidth(srcWidth)
+, srcHeight(srcHeight)
+, dstWidth(dstWidth)
+, dstHeight(dstHeight)
+, algo(algo)
+, planes(colorPlanes)
+, depth(bitDepth)
+, linear(linearLight && bitDepth == 8)
+, premultiplied(premultiplyAlpha && (colorPlanes == 2 || colorPlanes == 4))
+{
+    if (srcWidth == 0 || srcHeight == 0 || dstWidth == 0 || dstHeight == 0)
+    {
+        throw std::runtime_error("Failed to resize image, invalid dimensions requested");
+    }
+
+    const resize::Geometry geometry { srcWidth, srcHeight, dstWidth, dstHeight };
+    if (linear)
+    {
+        plan = resize::createLinearLightPlan(geometry, colorPlanes, algo, premultiplied);
+    }
+    else if (premultiplied)
+    {
+        plan = resize::createPremultipliedPlan(geometry, colorPlanes, bitDepth, algo);
+    }
+    else
+    {
+        plan = resize::createPlan(geometry, colorPlanes, bitDepth, algo);
+    }
+}
+
+uint32_t ResizePlan::sourceWidth() const
+{
+    return srcWidth;
+}
+
+uint32_t ResizePlan::sourceHeight() const
+{
+    return srcHeight;
+}
+
+uint32_t ResizePlan::targetWidth() const
+{
+    return dstWidth;
+}
+
+uint32_t ResizePlan::targetHeight() const
+{
+    return dstHeight;
+}
+
+ResizeAlgorithm ResizePlan::algorithm() const
+{
+    return algo;
+}
+
+uint32_t ResizePlan::colorPlanes() const
+{
+    return planes;
+}
+
+uint32_t ResizePlan::bitDepth() const
+{
+    return depth;
+}
+
+bool ResizePlan::linearLight() const
+{
+    return linear;
+}
+
+bool ResizePlan::premultipliedAlpha() const
+{
+    return premultiplied;
+}
+
+void ResizePlan::run(const ImageView& src, Image& dst) const
+{
+    run(src, dst, ResizeOptions());
+}
+
+void ResizePlan::run(const ImageView& src, Image& dst, const ResizeOptions& options) const
+{
+    // allocating the destination would invalidate a view on its pixels
+    const std::less<const uint8_t*> before;
+    if (!dst.data.empty() && !before(src.data, dst.data.data()) && before(src.data, dst.data.data() + dst.data.size()))
+    {
+        throw std::runtime_error("Failed to resize image, the destination can not be the source image");
+    }
+
+    dst.allocate(dstWidth, dstHeight, planes, depth);
+    run(src, dst.data.data(), dst.stride, options);
+}
+
+void ResizePlan::run(const ImageView& src, uint8_t* dst, uint32_t stride) const
+{
+    run(src, dst, stride, ResizeOptions());
+}
+
+void ResizePlan::run(const ImageView& src, uint8_t* dst, uint32_t stride, const ResizeOptions& options) const
+{
+    if (src.width != srcWidth || src.height != srcHeight || src.colorPlanes != planes || src.bitDepth != depth)
+    {
+        throw std::runtime_error("Failed to resize image, the image does not match the resize plan");
+    }
+
+    if (src.data == nullptr)
+    {
+        throw std::runtime_error("Failed to resize image, no data present");
+    }
+
+    const uint32_t pixelSize = planes * (depth / 8);
+    if (src.stride < srcWidth * pixelSize)
+    {
+        throw std::runtime_error("Failed to resize image, source stride is too small");
+    }
+
+    if (stride < dstWidth * pixelSize)
+    {
+        throw std::runtime_error("Failed to resize image, destination stride is too small");
+    }
+
+    const resize::Source source { src.data, srcWidth, srcHeight, src.stride };
+    const resize::Target target { dst, dstWidth, dstHeight, stride };
+    plan->run(source, target, options);
+}
+
+std::pair<uint32_t, uint32_t> ResizePlan::sourceRows(uint32_t begin, uint32_t end) const
+{
+    const auto range = plan->sourceRows(begin, end);
+    return std::make_pair(range.first, range.last);
+}
+
+std::pair<uint32_t, uint32_t> ResizePlan::sourceColumns(uint32_t begin, uint32_t end) const
+{
+    const auto range = plan->sourceColumns(begin, end);
+    return std::make_pair(range.first, range.last);
+}
+
+void ResizePlan::runRegion(const ImageView& srcRegion, uint32_t firstColumn, uint32_t firstRow, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint8_t* dst, uint32_t stride, const ResizeOptions& options) const
+{
+    if (srcRegion.colorPlanes != planes || srcRegion.bitDepth != depth || width == 0 || height == 0 || x + width > dstWidth || y + height > dstHeight)
+    {
+        throw std::runtime_error("Failed to resize image, the region does not match the resize plan");
+    }
+
+    const auto rows = plan->sourceRows(y, y + height);
+    const auto columns = plan->sourceColumns(x, x + width);
+    if (srcRegion.data == nullptr || rows.first < firstRow || rows.last > firstRow + srcRegion.height ||
+        columns.first < firstColumn || columns.last > firstColumn + srcRegion.width)
+    {
+        throw std::runtime_error("Failed to resize image, the required source pixels are not present");
+    }
+
+    const uint32_t pixelSize = planes * (depth / 8);
+    const resize::Source source { srcRegion.data, srcWidth, srcHeight, srcRegion.stride, firstRow, firstColumn * pixelSize };
+    const resize::Target target { dst, dstWidth, dstHeight, stride, y, x * pixelSize };
+    forEachBand(height, options, [&] (uint32_t bandBegin, uint32_t bandEnd) {
+        plan->runRows(source, target, y + bandBegin, y + bandEnd, { x, x + width });
+    });
+}
+
+}
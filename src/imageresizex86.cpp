@@ -0,0 +1,472 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "imageresize.h"
+
+#ifdef IMAGE_X86_SIMD
+
+#include <cstring>
+#include <immintrin.h>
+
+namespace image
+{
+namespace resize
+{
+
+static inline int32_t load32(const uint8_t* data)
+{
+    int32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// The kernels below interpolate 16-bit lanes: every pixel is loaded as a 32-bit value and split
+// in its even (red, blue) and odd (green, alpha) bytes, the 8-bit weights are broadcast to both
+// 16-bit halves of the pixel.
+
+IMAGE_TARGET_SSE41 static inline __m128i interpolateSse41(__m128i a, __m128i b, __m128i weight1, __m128i weight)
+{
+    const __m128i rounding = _mm_set1_epi16(128);
+    const __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(a, weight1), _mm_mullo_epi16(b, weight)), rounding);
+    return _mm_srli_epi16(sum, 8);
+}
+
+IMAGE_TARGET_SSE41 static inline __m128i loadPixelsSse41(const uint8_t* row, const uint32_t* offsets)
+{
+    return _mm_setr_epi32(load32(row + offsets[0]), load32(row + offsets[1]), load32(row + offsets[2]), load32(row + offsets[3]));
+}
+
+template <uint32_t Channels>
+IMAGE_TARGET_SSE41 static inline void storePixelsSse41(__m128i pixels, uint8_t* dst);
+
+template <>
+IMAGE_TARGET_SSE41 inline void storePixelsSse41<4>(__m128i pixels, uint8_t* dst)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), pixels);
+}
+
+template <>
+IMAGE_TARGET_SSE41 inline void storePixelsSse41<3>(__m128i pixels, uint8_t* dst)
+{
+    const __m128i packRgb = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    pixels = _mm_shuffle_epi8(pixels, packRgb);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), pixels);
+    const int32_t last = _mm_extract_epi32(pixels, 2);
+    std::memcpy(dst + 8, &last, sizeof(last));
+}
+
+template <uint32_t Channels>
+IMAGE_TARGET_SSE41 static inline void bilinearPixelsSse41(const BilinearRow& row, const BilinearColumns& columns,
+                                                          uint32_t x, __m128i wy1, __m128i wy, uint8_t* dst)
+{
+    const __m128i evenBytes = _mm_set1_epi16(0x00FF);
+
+    __m128i wx = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(load32(&columns.weight[x])));
+    wx = _mm_or_si128(wx, _mm_slli_epi32(wx, 16));
+    const __m128i wx1 = _mm_sub_epi16(_mm_set1_epi16(256), wx);
+
+    const __m128i p1 = loadPixelsSse41(row.top, &columns.left[x]);
+    const __m128i p2 = loadPixelsSse41(row.top, &columns.right[x]);
+    const __m128i p3 = loadPixelsSse41(row.bottom, &columns.left[x]);
+    const __m128i p4 = loadPixelsSse41(row.bottom, &columns.right[x]);
+
+    const __m128i topEven = interpolateSse41(_mm_and_si128(p1, evenBytes), _mm_and_si128(p2, evenBytes), wx1, wx);
+    const __m128i topOdd = interpolateSse41(_mm_srli_epi16(p1, 8), _mm_srli_epi16(p2, 8), wx1, wx);
+    const __m128i bottomEven = interpolateSse41(_mm_and_si128(p3, evenBytes), _mm_and_si128(p4, evenBytes), wx1, wx);
+    const __m128i bottomOdd = interpolateSse41(_mm_srli_epi16(p3, 8), _mm_srli_epi16(p4, 8), wx1, wx);
+
+    const __m128i even = interpolateSse41(topEven, bottomEven, wy1, wy);
+    const __m128i odd = interpolateSse41(topOdd, bottomOdd, wy1, wy);
+
+    storePixelsSse41<Channels>(_mm_or_si128(even, _mm_slli_epi16(odd, 8)), dst + (x * Channels));
+}
+
+template <uint32_t Channels>
+IMAGE_TARGET_SSE41 uint32_t bilinearRowSse41(const BilinearRow& row, const BilinearColumns& columns, uint32_t begin, uint32_t end, uint8_t* dst)
+{
+    const __m128i wy = _mm_set1_epi16(static_cast<int16_t>(row.weight));
+    const __m128i wy1 = _mm_set1_epi16(static_cast<int16_t>(256 - row.weight));
+
+    uint32_t x = begin;
+    for (; x + 8 <= end; x += 8)
+    {
+        bilinearPixelsSse41<Channels>(row, columns, x, wy1, wy, dst);
+        bilinearPixelsSse41<Channels>(row, columns, x + 4, wy1, wy, dst);
+    }
+
+    return x;
+}
+
+IMAGE_TARGET_AVX2 static inline __m256i interpolateAvx2(__m256i a, __m256i b, __m256i weight1, __m256i weight)
+{
+    const __m256i rounding = _mm256_set1_epi16(128);
+    const __m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(a, weight1), _mm256_mullo_epi16(b, weight)), rounding);
+    return _mm256_srli_epi16(sum, 8);
+}
+
+IMAGE_TARGET_AVX2 static inline __m256i loadPixelsAvx2(const uint8_t* row, const uint32_t* offsets)
+{
+    const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(offsets));
+    return _mm256_i32gather_epi32(reinterpret_cast<const int*>(row), indices, 1);
+}
+
+template <uint32_t Channels>
+IMAGE_TARGET_AVX2 static inline void storePixelsAvx2(__m256i pixels, uint8_t* dst);
+
+template <>
+IMAGE_TARGET_AVX2 inline void storePixelsAvx2<4>(__m256i pixels, uint8_t* dst)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), pixels);
+}
+
+template <>
+IMAGE_TARGET_AVX2 inline void storePixelsAvx2<3>(__m256i pixels, uint8_t* dst)
+{
+    const __m256i packRgb = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                             0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    // pack both halves to 12 bytes, the 4 trailing bytes of each half are not stored
+    pixels = _mm256_shuffle_epi8(pixels, packRgb);
+    const __m128i low = _mm256_castsi256_si128(pixels);
+    const __m128i high = _mm256_extracti128_si256(pixels, 1);
+
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), low);
+    const int32_t lowLast = _mm_cvtsi128_si32(_mm_srli_si128(low, 8));
+    std::memcpy(dst + 8, &lowLast, sizeof(lowLast));
+
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 12), high);
+    const int32_t highLast = _mm_cvtsi128_si32(_mm_srli_si128(high, 8));
+    std::memcpy(dst + 20, &highLast, sizeof(highLast));
+}
+
+template <uint32_t Channels>
+IMAGE_TARGET_AVX2 uint32_t bilinearRowAvx2(const BilinearRow& row, const BilinearColumns& columns, uint32_t begin, uint32_t end, uint8_t* dst)
+{
+    const __m256i evenBytes = _mm256_set1_epi16(0x00FF);
+    const __m256i wy = _mm256_set1_epi16(static_cast<int16_t>(row.weight));
+    const __m256i wy1 = _mm256_set1_epi16(static_cast<int16_t>(256 - row.weight));
+
+    uint32_t x = begin;
+    for (; x + 8 <= end; x += 8)
+    {
+        __m256i wx = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&columns.weight[x])));
+        wx = _mm256_or_si256(wx, _mm256_slli_epi32(wx, 16));
+        const __m256i wx1 = _mm256_sub_epi16(_mm256_set1_epi16(256), wx);
+
+        const __m256i p1 = loadPixelsAvx2(row.top, &columns.left[x]);
+        const __m256i p2 = loadPixelsAvx2(row.top, &columns.right[x]);
+        const __m256i p3 = loadPixelsAvx2(row.bottom, &columns.left[x]);
+        const __m256i p4 = loadPixelsAvx2(row.bottom, &columns.right[x]);
+
+        const __m256i topEven = interpolateAvx2(_mm256_and_si256(p1, evenBytes), _mm256_and_si256(p2, evenBytes), wx1, wx);
+        const __m256i topOdd = interpolateAvx2(_mm256_srli_epi16(p1, 8), _mm256_srli_epi16(p2, 8), wx1, wx);
+        const __m256i bottomEven = interpolateAvx2(_mm256_and_si256(p3, evenBytes), _mm256_and_si256(p4, evenBytes), wx1, wx);
+        const __m256i bottomOdd = interpolateAvx2(_mm256_srli_epi16(p3, 8), _mm256_srli_epi16(p4, 8), wx1, wx);
+
+        const __m256i even = interpolateAvx2(topEven, bottomEven, wy1, wy);
+        const __m256i odd = interpolateAvx2(topOdd, bottomOdd, wy1, wy);
+        storePixelsAvx2<Channels>(_mm256_or_si256(even, _mm256_slli_epi16(odd, 8)), dst + (x * Channels));
+    }
+
+    return x;
+}
+
+// Loads 4 consecutive pixels with every pixel in a 32-bit lane, the 3 channel variant reads
+// 4 bytes past the last pixel
+template <uint32_t Channels>
+IMAGE_TARGET_SSE41 static inline __m128i loadConsecutivePixelsSse41(const uint8_t* src);
+
+template <>
+IMAGE_TARGET_SSE41 inline __m128i loadConsecutivePixelsSse41<4>(const uint8_t* src)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+template <>
+IMAGE_TARGET_SSE41 inline __m128i loadConsecutivePixelsSse41<3>(const uint8_t* src)
+{
+    const __m128i expandRgb = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)), expandRgb);
+}
+
+template <uint32_t Factor>
+struct BoxShift
+{
+    static_assert(Factor == 2 || Factor == 4 || Factor == 8, "Unsupported box reduction factor");
+    static constexpr int value = Factor == 2 ? 2 : (Factor == 4 ? 4 : 6);
+};
+
+// The box kernels sum the source rows in 16-bit lanes holding two pixels and then add the
+// neighbouring pixels until every lane holds the sum of a complete block (at most 64 * 255).
+
+// [a0, a1], [b0, b1] -> [a0 + a1, b0 + b1]
+IMAGE_TARGET_SSE41 static inline __m128i addPixelPairsSse41(__m128i a, __m128i b)
+{
+    return _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+}
+
+template <uint32_t Channels, uint32_t Factor>
+IMAGE_TARGET_SSE41 uint32_t boxRowSse41(const uint8_t* const* rows, uint32_t count, uint8_t* dst)
+{
+    // two pixels per vector, 4 destination pixels per iteration
+    constexpr uint32_t vectors = 2 * Factor;
+    // keep the overlong loads of the 3 channel pixels within the row
+    constexpr uint32_t reserved = Channels == 3 ? 1 : 0;
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi16((Factor * Factor) / 2);
+
+    uint32_t x = 0;
+    for (; x + 4 + reserved <= count; x += 4)
+    {
+        __m128i sums[vectors];
+        for (uint32_t i = 0; i < vectors; ++i)
+        {
+            sums[i] = zero;
+        }
+
+        for (uint32_t row = 0; row < Factor; ++row)
+        {
+            const uint8_t* src = rows[row] + (x * Factor * Channels);
+            for (uint32_t i = 0; i < Factor; ++i)
+            {
+                const __m128i pixels = loadConsecutivePixelsSse41<Channels>(src + (i * 4 * Channels));
+                sums[2 * i] = _mm_add_epi16(sums[2 * i], _mm_cvtepu8_epi16(pixels));
+                sums[2 * i + 1] = _mm_add_epi16(sums[2 * i + 1], _mm_unpackhi_epi8(pixels, zero));
+            }
+        }
+
+        for (uint32_t n = vectors; n > 2; n /= 2)
+        {
+            for (uint32_t i = 0; i < n / 2; ++i)
+            {
+                sums[i] = addPixelPairsSse41(sums[2 * i], sums[2 * i + 1]);
+            }
+        }
+
+        const __m128i low = _mm_srli_epi16(_mm_add_epi16(sums[0], rounding), BoxShift<Factor>::value);
+        const __m128i high = _mm_srli_epi16(_mm_add_epi16(sums[1], rounding), BoxShift<Factor>::value);
+        storePixelsSse41<Channels>(_mm_packus_epi16(low, high), dst + (x * Channels));
+    }
+
+    return x;
+}
+
+// [a0, a1 | a2, a3], [b0, b1 | b2, b3] -> [a0 + a1, a2 + a3 | b0 + b1, b2 + b3]
+// the 64-bit unpacks operate per 128-bit lane, the permute restores the pixel order
+IMAGE_TARGET_AVX2 static inline __m256i addPixelPairsAvx2(__m256i a, __m256i b)
+{
+    const __m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(a, b), _mm256_unpackhi_epi64(a, b));
+    return _mm256_permute4x64_epi64(sum, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+template <uint32_t Channels, uint32_t Factor>
+IMAGE_TARGET_AVX2 uint32_t boxRowAvx2(const uint8_t* const* rows, uint32_t count, uint8_t* dst)
+{
+    // four pixels per vector, 8 destination pixels per iteration
+    constexpr uint32_t vectors = 2 * Factor;
+    constexpr uint32_t reserved = Channels == 3 ? 1 : 0;
+
+    const __m256i rounding = _mm256_set1_epi16((Factor * Factor) / 2);
+
+    uint32_t x = 0;
+    for (; x + 8 + reserved <= count; x += 8)
+    {
+        __m256i sums[vectors];
+        for (uint32_t i = 0; i < vectors; ++i)
+        {
+            sums[i] = _mm256_setzero_si256();
+        }
+
+        for (uint32_t row = 0; row < Factor; ++row)
+        {
+            const uint8_t* src = rows[row] + (x * Factor * Channels);
+            for (uint32_t i = 0; i < vectors; ++i)
+            {
+                const __m128i pixels = loadConsecutivePixelsSse41<Channels>(src + (i * 4 * Channels));
+                sums[i] = _mm256_add_epi16(sums[i], _mm256_cvtepu8_epi16(pixels));
+            }
+        }
+
+        for (uint32_t n = vectors; n > 2; n /= 2)
+        {
+            for (uint32_t i = 0; i < n / 2; ++i)
+            {
+                sums[i] = addPixelPairsAvx2(sums[2 * i], sums[2 * i + 1]);
+            }
+        }
+
+        const __m256i low = _mm256_srli_epi16(_mm256_add_epi16(sums[0], rounding), BoxShift<Factor>::value);
+        const __m256i high = _mm256_srli_epi16(_mm256_add_epi16(sums[1], rounding), BoxShift<Factor>::value);
+        const __m256i pixels = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), _MM_SHUFFLE(3, 1, 2, 0));
+        storePixelsAvx2<Channels>(pixels, dst + (x * Channels));
+    }
+
+    return x;
+}
+
+// The alpha kernels process 8-bit RGBA pixels in 32-bit lanes, the alpha value is the most
+// significant byte of a lane. Premultiplying multiplies the even (red, blue) and odd (green, alpha)
+// bytes in 16-bit lanes, unpremultiplying multiplies every channel in 32-bit lanes with the
+// reciprocal of the alpha value.
+
+IMAGE_TARGET_SSE41 static inline __m128i divideBy255Sse41(__m128i value)
+{
+    value = _mm_add_epi16(value, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+}
+
+IMAGE_TARGET_SSE41 static inline __m128i premultiplyPixelsSse41(__m128i pixels)
+{
+    const __m128i evenBytes = _mm_set1_epi16(0x00FF);
+
+    __m128i alpha = _mm_srli_epi32(pixels, 24);
+    alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+
+    const __m128i even = divideBy255Sse41(_mm_mullo_epi16(_mm_and_si128(pixels, evenBytes), alpha));
+    const __m128i odd = divideBy255Sse41(_mm_mullo_epi16(_mm_srli_epi16(pixels, 8), alpha));
+
+    const __m128i result = _mm_or_si128(even, _mm_slli_epi16(odd, 8));
+    return _mm_blendv_epi8(result, pixels, _mm_set1_epi32(0xFF000000));
+}
+
+IMAGE_TARGET_SSE41 static inline __m128i unpremultiplyChannelSse41(__m128i color, __m128i reciprocals)
+{
+    const __m128i value = _mm_add_epi32(_mm_mullo_epi32(color, reciprocals), _mm_set1_epi32(32768));
+    return _mm_min_epu32(_mm_srli_epi32(value, 16), _mm_set1_epi32(255));
+}
+
+IMAGE_TARGET_SSE41 static inline __m128i unpremultiplyPixelsSse41(__m128i pixels, __m128i reciprocals)
+{
+    const __m128i lowByte = _mm_set1_epi32(0xFF);
+
+    const __m128i red = unpremultiplyChannelSse41(_mm_and_si128(pixels, lowByte), reciprocals);
+    const __m128i green = unpremultiplyChannelSse41(_mm_and_si128(_mm_srli_epi32(pixels, 8), lowByte), reciprocals);
+    const __m128i blue = unpremultiplyChannelSse41(_mm_and_si128(_mm_srli_epi32(pixels, 16), lowByte), reciprocals);
+    const __m128i alpha = _mm_and_si128(pixels, _mm_set1_epi32(0xFF000000));
+
+    return _mm_or_si128(_mm_or_si128(red, _mm_slli_epi32(green, 8)), _mm_or_si128(_mm_slli_epi32(blue, 16), alpha));
+}
+
+IMAGE_TARGET_SSE41 uint32_t premultiplyRowSse41(const uint8_t* src, uint8_t* dst, uint32_t count)
+{
+    uint32_t x = 0;
+    for (; x + 4 <= count; x += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (x * 4)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (x * 4)), premultiplyPixelsSse41(pixels));
+    }
+
+    return x;
+}
+
+IMAGE_TARGET_SSE41 uint32_t unpremultiplyRowSse41(const uint8_t* src, uint8_t* dst, uint32_t count)
+{
+    const uint32_t* table = alphaReciprocals();
+
+    uint32_t x = 0;
+    for (; x + 4 <= count; x += 4)
+    {
+        const uint8_t* pixel = src + (x * 4);
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel));
+        const __m128i reciprocals = _mm_setr_epi32(table[pixel[3]], table[pixel[7]], table[pixel[11]], table[pixel[15]]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (x * 4)), unpremultiplyPixelsSse41(pixels, reciprocals));
+    }
+
+    return x;
+}
+
+IMAGE_TARGET_AVX2 static inline __m256i divideBy255Avx2(__m256i value)
+{
+    value = _mm256_add_epi16(value, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(value, _mm256_srli_epi16(value, 8)), 8);
+}
+
+IMAGE_TARGET_AVX2 static inline __m256i unpremultiplyChannelAvx2(__m256i color, __m256i reciprocals)
+{
+    const __m256i value = _mm256_add_epi32(_mm256_mullo_epi32(color, reciprocals), _mm256_set1_epi32(32768));
+    return _mm256_min_epu32(_mm256_srli_epi32(value, 16), _mm256_set1_epi32(255));
+}
+
+IMAGE_TARGET_AVX2 uint32_t premultiplyRowAvx2(const uint8_t* src, uint8_t* dst, uint32_t count)
+{
+    const __m256i evenBytes = _mm256_set1_epi16(0x00FF);
+    const __m256i alphaMask = _mm256_set1_epi32(0xFF000000);
+
+    uint32_t x = 0;
+    for (; x + 8 <= count; x += 8)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + (x * 4)));
+
+        __m256i alpha = _mm256_srli_epi32(pixels, 24);
+        alpha = _mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 16));
+
+        const __m256i even = divideBy255Avx2(_mm256_mullo_epi16(_mm256_and_si256(pixels, evenBytes), alpha));
+        const __m256i odd = divideBy255Avx2(_mm256_mullo_epi16(_mm256_srli_epi16(pixels, 8), alpha));
+
+        const __m256i result = _mm256_or_si256(even, _mm256_slli_epi16(odd, 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + (x * 4)), _mm256_blendv_epi8(result, pixels, alphaMask));
+    }
+
+    return x;
+}
+
+IMAGE_TARGET_AVX2 uint32_t unpremultiplyRowAvx2(const uint8_t* src, uint8_t* dst, uint32_t count)
+{
+    const int* table = reinterpret_cast<const int*>(alphaReciprocals());
+    const __m256i lowByte = _mm256_set1_epi32(0xFF);
+    const __m256i alphaMask = _mm256_set1_epi32(0xFF000000);
+
+    uint32_t x = 0;
+    for (; x + 8 <= count; x += 8)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + (x * 4)));
+        const __m256i reciprocals = _mm256_i32gather_epi32(table, _mm256_srli_epi32(pixels, 24), 4);
+
+        const __m256i red = unpremultiplyChannelAvx2(_mm256_and_si256(pixels, lowByte), reciprocals);
+        const __m256i green = unpremultiplyChannelAvx2(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), lowByte), reciprocals);
+        const __m256i blue = unpremultiplyChannelAvx2(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), lowByte), reciprocals);
+
+        const __m256i result = _mm256_or_si256(_mm256_or_si256(red, _mm256_slli_epi32(green, 8)),
+                                               _mm256_or_si256(_mm256_slli_epi32(blue, 16), _mm256_and_si256(pixels, alphaMask)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + (x * 4)), result);
+    }
+
+    return x;
+}
+
+template uint32_t bilinearRowSse41<3>(const BilinearRow&, const BilinearColumns&, uint32_t, uint32_t, uint8_t*);
+template uint32_t bilinearRowSse41<4>(const BilinearRow&, const BilinearColumns&, uint32_t, uint32_t, uint8_t*);
+template uint32_t bilinearRowAvx2<3>(const BilinearRow&, const BilinearColumns&, uint32_t, uint32_t, uint8_t*);
+template uint32_t bilinearRowAvx2<4>(const BilinearRow&, const BilinearColumns&, uint32_t, uint32_t, uint8_t*);
+
+template uint32_t boxRowSse41<3, 2>(const uint8_t* const*, uint32_t, uint8_t*);
+template uint32_t boxRowSse41<3, 4>(const uint8_t* const*, uint32_t, uint8_t*);
+template uint32_t boxRowSse41<3, 8>(const uint8_t* const*, uint32_t, uint8_t*);
+template uint32_t boxRowSse41<4, 2>(const uint8_t* const*, uint32_t, uint8_t*);
+template uint32_t boxRowSse41<4, 4>(const uint8_t* const*, uint32_t, uint8_t*);
+template uint32_t boxRowSse41<4, 8>(const uint8_t* const*, uint32_t, uint8_t*);
+template uint32_t boxRowAvx2<3, 2>(const uint8_t* const*, uint32_t, uint8_t*);
+template uint32_t boxRowAvx2<3, 4>(const uint8_t* const*, uint32_t, uint8_t*);
+template uint32_t boxRowAvx2<3, 8>(const uint8_t* const*, uint32_t, uint8_t*);
+template uint32_t boxRowAvx2<4, 2>(const uint8_t* const*, uint32_t, uint8_t*);
+template uint32_t boxRowAvx2<4, 4>(const uint8_t* const*, uint32_t, uint8_t*);
+template uint32_t boxRowAvx2<4, 8>(const uint8_t* const*, uint32_t, uint8_t*);
+
+}
+}
+
+#endif
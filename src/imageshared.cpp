@@ -0,0 +1,193 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#include "image/imageshared.h"
+
+#include <atomic>
+#include <utility>
+
+namespace image
+{
+
+// The reference count is decremented with release and checked with acquire semantics, so reads of
+// the pixels through a copy that is dropped happen before the pixels are modified by the last owner
+struct SharedImage::Shared
+{
+    explicit Shared(Image&& image)
+    : image(std::move(image))
+    {
+    }
+
+    std::atomic<uint32_t>   references { 1 };
+    uint32_t                writers = 0;    // only modified while this is the only reference
+    Image                   image;
+};
+
+SharedImage::Writer::Writer(Shared* shared)
+: shared(shared)
+{
+    ++shared->writers;
+}
+
+SharedImage::Writer::Writer(Writer&& other)
+: shared(std::exchange(other.shared, nullptr))
+{
+}
+
+SharedImage::Writer::~Writer()
+{
+    if (shared)
+    {
+        --shared->writers;
+    }
+}
+
+Image& SharedImage::Writer::operator*() const
+{
+    return shared->image;
+}
+
+Image* SharedImage::Writer::operator->() const
+{
+    return &shared->image;
+}
+
+SharedImage::SharedImage(Image&& image)
+: shared(new Shared(std::move(image)))
+{
+}
+
+SharedImage::SharedImage(std::unique_ptr<Image> image)
+: shared(image ? new Shared(std::move(*image)) : nullptr)
+{
+}
+
+SharedImage::SharedImage(const SharedImage& other)
+: shared(other.shared)
+{
+    if (shared && shared->writers > 0)
+    {
+        // the image can still be modified through the writer
+        shared = new Shared(other.shared->image.clone());
+    }
+    else if (shared)
+    {
+        // a new reference can only be created from an existing one, no ordering is needed
+        shared->references.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+SharedImage::SharedImage(SharedImage&& other)
+: shared(std::exchange(other.shared, nullptr))
+{
+}
+
+SharedImage::~SharedImage()
+{
+    releaseReference();
+}
+
+SharedImage& SharedImage::operator=(const SharedImage& other)
+{
+    if (this != &other)
+    {
+        SharedImage copy(other);
+        std::swap(shared, copy.shared);
+    }
+
+    return *this;
+}
+
+SharedImage& SharedImage::operator=(SharedImage&& other)
+{
+    if (this != &other)
+    {
+        releaseReference();
+        shared = std::exchange(other.shared, nullptr);
+    }
+
+    return *this;
+}
+
+void SharedImage::releaseReference()
+{
+    if (shared && shared->references.fetch_sub(1, std::memory_order_release) == 1)
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        delete shared;
+    }
+
+    shared = nullptr;
+}
+
+const Image& SharedImage::image() const
+{
+    return shared->image;
+}
+
+const Image* SharedImage::operator->() const
+{
+    return &shared->image;
+}
+
+ImageView SharedImage::view() const
+{
+    return ImageView(shared->image);
+}
+
+SharedImage::Writer SharedImage::mutableImage()
+{
+    if (!shared)
+    {
+        shared = new Shared(Image());
+    }
+    else if (isShared())
+    {
+        // the other copies keep the original, they can not see the modifications
+        auto* copy = new Shared(shared->image.clone());
+        releaseReference();
+        shared = copy;
+    }
+
+    return Writer(shared);
+}
+
+Image SharedImage::release()
+{
+    if (!shared)
+    {
+        return Image();
+    }
+
+    auto image = isShared() ? shared->image.clone() : std::move(shared->image);
+    releaseReference();
+    return image;
+}
+
+bool SharedImage::isShared() const
+{
+    // synchronizes with the release of the other references, when the count is 1 no other
+    // thread can create a new copy, so the answer can not become outdated
+    return shared && shared->references.load(std::memory_order_acquire) > 1;
+}
+
+SharedImage::operator bool() const
+{
+    return shared != nullptr;
+}
+
+}
@@ -0,0 +1,263 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#include "image/imagesharedmemory.h"
+
+#include <string>
+#include <utility>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace image
+{
+
+#ifdef __linux__
+// Seals that guarantee the receiver that the pixels do not change while it reads them
+static constexpr int PixelSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+#else
+static void throwUnsupported()
+{
+    throw std::runtime_error("Shared memory images are not supported on this platform");
+}
+#endif
+
+SharedMemoryImage::SharedMemoryImage(SharedMemoryImage&& other)
+{
+    *this = std::move(other);
+}
+
+SharedMemoryImage::~SharedMemoryImage()
+{
+    release();
+}
+
+SharedMemoryImage& SharedMemoryImage::operator=(SharedMemoryImage&& other)
+{
+    if (this != &other)
+    {
+        release();
+        descriptor = std::exchange(other.descriptor, -1);
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+        readOnly = std::exchange(other.readOnly, true);
+        width = std::exchange(other.width, 0);
+        height = std::exchange(other.height, 0);
+        stride = std::exchange(other.stride, 0);
+        pixelFormat = other.pixelFormat;
+    }
+
+    return *this;
+}
+
+void SharedMemoryImage::release()
+{
+#ifdef __linux__
+    if (data != nullptr)
+    {
+        munmap(data, size);
+    }
+
+    if (descriptor >= 0)
+    {
+        close(descriptor);
+    }
+#endif
+
+    descriptor = -1;
+    data = nullptr;
+    size = 0;
+}
+
+SharedMemoryImage SharedMemoryImage::create(uint32_t width, uint32_t height, PixelFormat format)
+{
+#ifdef __linux__
+    if (width == 0 || height == 0)
+    {
+        throw std::runtime_error("Failed to create shared memory image, invalid dimensions");
+    }
+
+    const uint32_t alignment = rowAlignment();
+    const uint32_t rowBytes = width * pixelSizeOf(format);
+
+    SharedMemoryImage image;
+    image.width = width;
+    image.height = height;
+    image.stride = ((rowBytes + alignment - 1) / alignment) * alignment;
+    image.pixelFormat = format;
+    image.size = size_t(image.stride) * height;
+
+    image.descriptor = memfd_create("image", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (image.descriptor < 0)
+    {
+        throw std::runtime_error("Failed to create shared memory image, memfd_create failed");
+    }
+
+    if (ftruncate(image.descriptor, static_cast<off_t>(image.size)) != 0)
+    {
+        throw std::runtime_error("Failed to create shared memory image, could not allocate " + std::to_string(image.size) + " bytes");
+    }
+
+    auto* memory = mmap(nullptr, image.size, PROT_READ | PROT_WRITE, MAP_SHARED, image.descriptor, 0);
+    if (memory == MAP_FAILED)
+    {
+        throw std::runtime_error("Failed to create shared memory image, mmap failed");
+    }
+
+    image.data = static_cast<uint8_t*>(memory);
+    image.readOnly = false;
+    return image;
+#else
+    (void)width; (void)height; (void)format;
+    throwUnsupported();
+    return SharedMemoryImage();
+#endif
+}
+
+SharedMemoryImage SharedMemoryImage::import(int fd, const SharedMemoryHeader& header)
+{
+#ifdef __linux__
+    SharedMemoryImage image;
+    image.descriptor = fd;
+
+    if (header.width == 0 || header.height == 0)
+    {
+        throw std::runtime_error("Failed to import shared memory image, invalid dimensions");
+    }
+
+    // throws for values that are not a pixel format
+    image.pixelFormat = static_cast<PixelFormat>(header.format);
+    const uint64_t rowBytes = uint64_t(header.width) * pixelSizeOf(image.pixelFormat);
+    if (header.stride < rowBytes)
+    {
+        throw std::runtime_error("Failed to import shared memory image, the stride is too small");
+    }
+
+    const int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & PixelSeals) != PixelSeals)
+    {
+        throw std::runtime_error("Failed to import shared memory image, the memory is not sealed");
+    }
+
+    struct stat info;
+    const uint64_t required = (uint64_t(header.stride) * (header.height - 1)) + rowBytes;
+    if (fstat(fd, &info) != 0 || uint64_t(info.st_size) < required)
+    {
+        throw std::runtime_error("Failed to import shared memory image, the memory is smaller than the image");
+    }
+
+    auto* memory = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+    {
+        throw std::runtime_error("Failed to import shared memory image, mmap failed");
+    }
+
+    image.data = static_cast<uint8_t*>(memory);
+    image.size = size_t(info.st_size);
+    image.width = header.width;
+    image.height = header.height;
+    image.stride = header.stride;
+    return image;
+#else
+    (void)fd; (void)header;
+    throwUnsupported();
+    return SharedMemoryImage();
+#endif
+}
+
+void SharedMemoryImage::seal()
+{
+#ifdef __linux__
+    if (readOnly)
+    {
+        return;
+    }
+
+    // writes can only be sealed when there are no shared mappings that could be made writable,
+    // the mapping of this image is the only writable one
+    munmap(data, size);
+    data = nullptr;
+
+    const bool sealed = fcntl(descriptor, F_ADD_SEALS, PixelSeals | F_SEAL_SEAL) == 0;
+    if (sealed)
+    {
+        readOnly = true;
+    }
+
+    auto* memory = mmap(nullptr, size, sealed ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    if (memory == MAP_FAILED)
+    {
+        throw std::runtime_error("Failed to seal shared memory image, mmap failed");
+    }
+
+    data = static_cast<uint8_t*>(memory);
+    if (!sealed)
+    {
+        // e.g. the memory is still mapped writable elsewhere, the image remains writable
+        throw std::runtime_error("Failed to seal shared memory image");
+    }
+#else
+    throwUnsupported();
+#endif
+}
+
+int SharedMemoryImage::fd() const
+{
+    return descriptor;
+}
+
+SharedMemoryHeader SharedMemoryImage::header() const
+{
+    SharedMemoryHeader result;
+    result.width = width;
+    result.height = height;
+    result.stride = stride;
+    result.format = static_cast<uint32_t>(pixelFormat);
+    return result;
+}
+
+PixelFormat SharedMemoryImage::format() const
+{
+    return pixelFormat;
+}
+
+bool SharedMemoryImage::writable() const
+{
+    return !readOnly;
+}
+
+uint8_t* SharedMemoryImage::row(uint32_t y)
+{
+    if (readOnly)
+    {
+        throw std::runtime_error("Shared memory image is read-only");
+    }
+
+    return data + (size_t(y) * stride);
+}
+
+ImageView SharedMemoryImage::view() const
+{
+    return ImageView(data, width, height, stride, pixelFormat);
+}
+
+}
@@ -0,0 +1,61 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "image/imagesimd.h"
+
+#include <atomic>
+
+#include "imageresize.h"
+
+namespace image
+{
+
+static std::atomic<SimdLevel>& activeLevel()
+{
+    static std::atomic<SimdLevel> level(detectSimdLevel());
+    return level;
+}
+
+SimdLevel detectSimdLevel()
+{
+#ifdef IMAGE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return SimdLevel::Avx2;
+    }
+
+    if (__builtin_cpu_supports("sse4.1"))
+    {
+        return SimdLevel::Sse41;
+    }
+#endif
+
+    return SimdLevel::None;
+}
+
+SimdLevel simdLevel()
+{
+    return activeLevel().load(std::memory_order_relaxed);
+}
+
+void setSimdLevel(SimdLevel level)
+{
+    auto detected = detectSimdLevel();
+    activeLevel().store(level > detected ? detected : level, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,434 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#include "image/imagetiled.h"
+
+#include "image/imageresizeplan.h"
+#include "image/imageloadstoreinterface.h"
+#include "utils/fileoperations.h"
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/types.h>
+#endif
+
+namespace image
+{
+
+// Evicted tiles are stored in a fixed slot per tile, the rows are stored tightly packed
+class TiledImage::SpillFile
+{
+public:
+#ifndef _WIN32
+    SpillFile(const std::string& directory, size_t slotSize)
+    : slotSize(slotSize)
+    {
+        auto path = directory + "/imagetilesXXXXXX";
+        fd = mkstemp(&path[0]);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to create tile file, " + path);
+        }
+
+        // only the descriptor keeps the file alive from now on
+        unlink(path.c_str());
+    }
+
+    ~SpillFile()
+    {
+        close(fd);
+    }
+
+    void write(uint32_t index, const Image& tile)
+    {
+        transfer(index, tile, [this] (uint8_t* data, size_t size, off_t offset) {
+            return pwrite(fd, data, size, offset);
+        });
+    }
+
+    void read(uint32_t index, Image& tile)
+    {
+        transfer(index, tile, [this] (uint8_t* data, size_t size, off_t offset) {
+            return pread(fd, data, size, offset);
+        });
+    }
+
+private:
+    template <typename Func>
+    void transfer(uint32_t index, const Image& tile, Func&& func)
+    {
+        const size_t rowBytes = size_t(tile.width) * tile.colorPlanes * (tile.bitDepth / 8);
+        const off_t slot = static_cast<off_t>(index * slotSize);
+
+        // the stride of a tile is only padded when a row alignment is configured
+        const bool packed = tile.rowStride() == rowBytes;
+        for (uint32_t y = 0; y < tile.height; y += packed ? tile.height : 1)
+        {
+            const size_t size = packed ? rowBytes * tile.height : rowBytes;
+            auto* data = const_cast<uint8_t*>(tile.row(y));
+            if (func(data, size, slot + static_cast<off_t>(y * rowBytes)) != static_cast<ssize_t>(size))
+            {
+                throw std::runtime_error("Failed to transfer tile " + std::to_string(index) + " to the tile file");
+            }
+        }
+    }
+
+    int     fd = -1;
+    size_t  slotSize;
+#else
+    SpillFile(const std::string&, size_t)
+    {
+        throw std::runtime_error("Failed to create tile file, not supported on this platform");
+    }
+
+    void write(uint32_t, const Image&) {}
+    void read(uint32_t, Image&) {}
+#endif
+};
+
+TiledImage::TiledImage() = default;
+TiledImage::TiledImage(TiledImage&&) = default;
+TiledImage::~TiledImage() = default;
+TiledImage& TiledImage::operator=(TiledImage&&) = default;
+
+TiledImage::TiledImage(uint32_t width, uint32_t height, PixelFormat format, uint32_t tileSize)
+{
+    reset(width, height, format, tileSize);
+}
+
+void TiledImage::reset(uint32_t newWidth, uint32_t newHeight, PixelFormat newFormat, uint32_t newTileSize)
+{
+    if (newTileSize == 0)
+    {
+        throw std::runtime_error("Invalid tile size");
+    }
+
+    imageWidth = newWidth;
+    imageHeight = newHeight;
+    pixelFormat = newFormat;
+    size = newTileSize;
+    tileColumns = (newWidth + newTileSize - 1) / newTileSize;
+    tileRows = (newHeight + newTileSize - 1) / newTileSize;
+
+    resident.clear();
+    spill.reset();
+    tiles.clear();
+    tiles.resize(size_t(tileColumns) * tileRows);
+    zeroRow.assign(size_t(newTileSize) * pixelSizeOf(newFormat), 0);
+}
+
+TiledImage TiledImage::fromImage(const ImageView& image, uint32_t tileSize)
+{
+    TiledImage tiled(image.width, image.height, image.format(), tileSize);
+    tiled.writeRows(0, image.height, image.data, image.stride);
+    return tiled;
+}
+
+Image TiledImage::toImage() const
+{
+    Image image;
+    image.allocate(imageWidth, imageHeight, pixelFormat);
+    readRows(0, imageHeight, image.data.data(), image.rowStride());
+    return image;
+}
+
+uint32_t TiledImage::width() const
+{
+    return imageWidth;
+}
+
+uint32_t TiledImage::height() const
+{
+    return imageHeight;
+}
+
+PixelFormat TiledImage::format() const
+{
+    return pixelFormat;
+}
+
+uint32_t TiledImage::tileSize() const
+{
+    return size;
+}
+
+uint32_t TiledImage::columns() const
+{
+    return tileColumns;
+}
+
+uint32_t TiledImage::rows() const
+{
+    return tileRows;
+}
+
+void TiledImage::setResidentTileLimit(uint32_t maxResidentTiles, const std::string& directory)
+{
+#ifdef _WIN32
+    if (maxResidentTiles > 0)
+    {
+        throw std::runtime_error("Failed to limit the resident tiles, not supported on this platform");
+    }
+#endif
+
+    residentLimit = maxResidentTiles;
+    spillDirectory = directory;
+    enforceResidentLimit(UINT32_MAX);
+}
+
+uint32_t TiledImage::residentTiles() const
+{
+    return static_cast<uint32_t>(resident.size());
+}
+
+bool TiledImage::isAllocated(uint32_t column, uint32_t row) const
+{
+    const auto& tile = tiles.at(size_t(row) * tileColumns + column);
+    return tile.stored || !tile.pixels.data.empty();
+}
+
+TiledImage::Tile* TiledImage::access(uint32_t column, uint32_t row, bool write) const
+{
+    if (column >= tileColumns || row >= tileRows)
+    {
+        throw std::runtime_error("Tile " + std::to_string(column) + "x" + std::to_string(row) + " is outside of the image");
+    }
+
+    const uint32_t index = (row * tileColumns) + column;
+    auto& tile = tiles[index];
+    if (!tile.pixels.data.empty())
+    {
+        resident.splice(resident.begin(), resident, tile.recentUse);
+    }
+    else if (tile.stored || write)
+    {
+        const uint32_t x = column * size;
+        const uint32_t y = row * size;
+        tile.pixels.allocate(std::min(size, imageWidth - x), std::min(size, imageHeight - y), pixelFormat);
+        if (tile.stored)
+        {
+            spill->read(index, tile.pixels);
+        }
+        else
+        {
+            std::fill(tile.pixels.data.begin(), tile.pixels.data.end(), uint8_t(0));
+        }
+
+        resident.push_front(index);
+        tile.recentUse = resident.begin();
+        enforceResidentLimit(index);
+    }
+    else
+    {
+        return nullptr;
+    }
+
+    tile.dirty = tile.dirty || write;
+    return &tile;
+}
+
+void TiledImage::evict(uint32_t index) const
+{
+    auto& tile = tiles[index];
+    if (tile.dirty || !tile.stored)
+    {
+        if (!spill)
+        {
+            const size_t slotSize = size_t(size) * size * pixelSizeOf(pixelFormat);
+            spill = std::make_unique<SpillFile>(spillDirectory, slotSize);
+        }
+
+        spill->write(index, tile.pixels);
+        tile.stored = true;
+        tile.dirty = false;
+    }
+
+    tile.pixels = Image();
+    resident.erase(tile.recentUse);
+}
+
+void TiledImage::enforceResidentLimit(uint32_t keep) const
+{
+    while (residentLimit > 0 && resident.size() > residentLimit && resident.back() != keep)
+    {
+        evict(resident.back());
+    }
+}
+
+ImageView TiledImage::tile(uint32_t column, uint32_t row) const
+{
+    const uint32_t tileWidth = std::min(size, imageWidth - (column * size));
+    const uint32_t tileHeight = std::min(size, imageHeight - (row * size));
+
+    auto* tile = access(column, row, false);
+    if (tile == nullptr)
+    {
+        // every row of an unwritten tile is the zero row
+        return ImageView(zeroRow.data(), tileWidth, tileHeight, 0, pixelFormat);
+    }
+
+    return ImageView(tile->pixels);
+}
+
+Image& TiledImage::writableTile(uint32_t column, uint32_t row)
+{
+    return access(column, row, true)->pixels;
+}
+
+void TiledImage::readRows(uint32_t y, uint32_t count, uint8_t* dst, uint32_t stride) const
+{
+    if (y + count > imageHeight)
+    {
+        throw std::runtime_error("Failed to read rows, the rows are outside of the image");
+    }
+
+    readRegion(0, y, imageWidth, count, dst, stride);
+}
+
+void TiledImage::writeRows(uint32_t y, uint32_t count, const uint8_t* src, uint32_t stride)
+{
+    if (y + count > imageHeight)
+    {
+        throw std::runtime_error("Failed to write rows, the rows are outside of the image");
+    }
+
+    const uint32_t pixelSize = pixelSizeOf(pixelFormat);
+    for (uint32_t row = y / size; count > 0 && row < tileRows && row * size < y + count; ++row)
+    {
+        const uint32_t begin = std::max(y, row * size);
+        const uint32_t end = std::min(y + count, (row + 1) * size);
+        for (uint32_t column = 0; column < tileColumns; ++column)
+        {
+            auto& tile = writableTile(column, row);
+            const size_t rowBytes = size_t(tile.width) * pixelSize;
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                std::memcpy(tile.row(i - (row * size)), src + (size_t(i - y) * stride) + (size_t(column) * size * pixelSize), rowBytes);
+            }
+        }
+    }
+}
+
+void TiledImage::readRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint8_t* dst, uint32_t stride) const
+{
+    if (x + width > imageWidth || y + height > imageHeight)
+    {
+        throw std::runtime_error("Failed to read region, the region is outside of the image");
+    }
+
+    const uint32_t pixelSize = pixelSizeOf(pixelFormat);
+    for (uint32_t row = y / size; height > 0 && row * size < y + height; ++row)
+    {
+        const uint32_t begin = std::max(y, row * size);
+        const uint32_t end = std::min(y + height, (row + 1) * size);
+        for (uint32_t column = x / size; width > 0 && column * size < x + width; ++column)
+        {
+            const uint32_t left = std::max(x, column * size);
+            const uint32_t right = std::min(x + width, (column + 1) * size);
+            const size_t rowBytes = size_t(right - left) * pixelSize;
+
+            const auto view = tile(column, row);
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                std::memcpy(dst + (size_t(i - y) * stride) + (size_t(left - x) * pixelSize), view.row(i - (row * size)) + (size_t(left - (column * size)) * pixelSize), rowBytes);
+            }
+        }
+    }
+}
+
+void TiledImage::resizeInto(TiledImage& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo) const
+{
+    resizeInto(dst, newWidth, newHeight, algo, ResizeOptions());
+}
+
+void TiledImage::resizeInto(TiledImage& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options) const
+{
+    if (&dst == this)
+    {
+        throw std::runtime_error("Failed to resize image, the destination can not be the source image");
+    }
+
+    const ResizePlan plan(imageWidth, imageHeight, newWidth, newHeight, algo, colorPlanesOf(pixelFormat), bitDepthOf(pixelFormat), options.linearLight, options.premultiplyAlpha);
+    dst.reset(newWidth, newHeight, pixelFormat, size);
+
+    const uint32_t pixelSize = pixelSizeOf(pixelFormat);
+
+    // the source pixels of one destination tile, the kernels can read up to 16 bytes past the last row
+    std::vector<uint8_t> sourceRegion;
+
+    for (uint32_t row = 0; row < dst.tileRows; ++row)
+    {
+        const uint32_t y = row * size;
+        const uint32_t height = std::min(size, newHeight - y);
+        const auto rows = plan.sourceRows(y, y + height);
+
+        for (uint32_t column = 0; column < dst.tileColumns; ++column)
+        {
+            const uint32_t x = column * size;
+            const uint32_t width = std::min(size, newWidth - x);
+            const auto columns = plan.sourceColumns(x, x + width);
+
+            const uint32_t regionWidth = columns.second - columns.first;
+            const uint32_t regionHeight = rows.second - rows.first;
+            const uint32_t regionStride = regionWidth * pixelSize;
+
+            sourceRegion.resize((size_t(regionHeight) * regionStride) + 16);
+            readRegion(columns.first, rows.first, regionWidth, regionHeight, sourceRegion.data(), regionStride);
+
+            const ImageView source(sourceRegion.data(), regionWidth, regionHeight, regionStride, pixelFormat);
+            auto& tile = dst.writableTile(column, row);
+            plan.runRegion(source, columns.first, rows.first, x, y, width, height, tile.data.data(), tile.rowStride(), options);
+        }
+    }
+}
+
+TiledRowReader::TiledRowReader(const TiledImage& image)
+: image(image)
+{
+    band.allocate(image.width(), std::min(image.tileSize(), image.height()), image.format());
+}
+
+const uint8_t* TiledRowReader::row(uint32_t y)
+{
+    if (y < bandBegin || y >= bandEnd)
+    {
+        bandBegin = y - (y % image.tileSize());
+        bandEnd = std::min(bandBegin + image.tileSize(), image.height());
+        image.readRows(bandBegin, bandEnd - bandBegin, band.data.data(), band.rowStride());
+    }
+
+    return band.row(y - bandBegin);
+}
+
+std::vector<uint8_t> storeToMemory(ILoadStore& store, const TiledImage& image)
+{
+    TiledRowReader reader(image);
+    return store.storeRowsToMemory(image.format(), image.width(), image.height(), [&] (uint32_t y) {
+        return reader.row(y);
+    });
+}
+
+void storeToFile(ILoadStore& store, const TiledImage& image, const std::string& path)
+{
+    utils::fileops::writeFile(storeToMemory(store, image), path);
+}
+
+}
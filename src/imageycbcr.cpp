@@ -0,0 +1,243 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+#include "image/imageycbcr.h"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "image/imagefactory.h"
+#include "imageconfig.h"
+
+#if HAVE_JPEG
+#include "imageloadstorejpeg.h"
+#endif
+
+namespace image
+{
+
+namespace
+{
+
+// JFIF conversion coefficients in 16.16 fixed point
+constexpr int32_t Scale = 1 << 16;
+constexpr int32_t RedToY = 19595;       // 0.299
+constexpr int32_t GreenToY = 38470;     // 0.587
+constexpr int32_t BlueToY = 7471;       // 0.114
+constexpr int32_t RedToCb = -11059;     // -0.168736
+constexpr int32_t GreenToCb = -21709;   // -0.331264
+constexpr int32_t BlueToCb = 32768;     // 0.5
+constexpr int32_t RedToCr = 32768;      // 0.5
+constexpr int32_t GreenToCr = -27439;   // -0.418688
+constexpr int32_t BlueToCr = -5329;     // -0.081312
+
+// Chroma contributions to the rgb values, indexed by the chroma sample
+struct ChromaTables
+{
+    ChromaTables()
+    {
+        for (int32_t i = 0; i < 256; ++i)
+        {
+            const double chroma = i - 128;
+            crToRed[i] = static_cast<int32_t>(std::lround(1.402 * chroma));
+            cbToBlue[i] = static_cast<int32_t>(std::lround(1.772 * chroma));
+            cbToGreen[i] = static_cast<int32_t>(std::lround(-0.344136 * chroma * Scale));
+            crToGreen[i] = static_cast<int32_t>(std::lround(-0.714136 * chroma * Scale));
+        }
+    }
+
+    int32_t crToRed[256];
+    int32_t cbToBlue[256];
+    int32_t cbToGreen[256];
+    int32_t crToGreen[256];
+};
+
+const ChromaTables& chromaTables()
+{
+    static const ChromaTables tables;
+    return tables;
+}
+
+uint8_t clampSample(int32_t value)
+{
+    return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+// sum of the color components of count pixels, rounded to the average chroma value
+uint8_t averageChroma(int32_t red, int32_t green, int32_t blue, int32_t count, int32_t toRed, int32_t toGreen, int32_t toBlue)
+{
+    // the offset of 128 keeps the sum positive
+    const int32_t sum = (red * toRed) + (green * toGreen) + (blue * toBlue) + (count * 128 * Scale);
+    return clampSample((sum + (count * Scale / 2)) / (count * Scale));
+}
+
+}
+
+void YCbCrImage::allocate(uint32_t width, uint32_t height)
+{
+    y.allocate(width, height, PixelFormat::Gray8);
+    cb.allocate((width + 1) / 2, (height + 1) / 2, PixelFormat::Gray8);
+    cr.allocate((width + 1) / 2, (height + 1) / 2, PixelFormat::Gray8);
+}
+
+uint32_t YCbCrImage::width() const
+{
+    return y.width;
+}
+
+uint32_t YCbCrImage::height() const
+{
+    return y.height;
+}
+
+YCbCrImage YCbCrImage::fromRgb(const ImageView& image)
+{
+    const auto format = image.format();
+    if (format != PixelFormat::Gray8 && format != PixelFormat::RGB8 && format != PixelFormat::RGBA8)
+    {
+        throw std::runtime_error("Failed to convert image to YCbCr, only 8-bit gray, RGB and RGBA images are supported");
+    }
+
+    const uint32_t planes = image.colorPlanes;
+    // gray pixels use the same sample for the three components
+    const uint32_t greenOffset = planes >= 3 ? 1 : 0;
+    const uint32_t blueOffset = planes >= 3 ? 2 : 0;
+
+    YCbCrImage result;
+    result.allocate(image.width, image.height);
+
+    for (uint32_t y = 0; y < image.height; ++y)
+    {
+        const uint8_t* src = image.row(y);
+        uint8_t* luma = result.y.row(y);
+
+        for (uint32_t x = 0; x < image.width; ++x)
+        {
+            const uint8_t* pixel = src + (x * planes);
+            luma[x] = static_cast<uint8_t>(((pixel[0] * RedToY) + (pixel[greenOffset] * GreenToY) + (pixel[blueOffset] * BlueToY) + (Scale / 2)) >> 16);
+        }
+    }
+
+    for (uint32_t y = 0; y < result.cb.height; ++y)
+    {
+        const uint8_t* rows[2] = { image.row(y * 2), image.row(std::min((y * 2) + 1, image.height - 1)) };
+        const int32_t rowCount = (y * 2) + 1 < image.height ? 2 : 1;
+
+        uint8_t* cb = result.cb.row(y);
+        uint8_t* cr = result.cr.row(y);
+
+        for (uint32_t x = 0; x < result.cb.width; ++x)
+        {
+            const int32_t columnCount = (x * 2) + 1 < image.width ? 2 : 1;
+
+            int32_t red = 0, green = 0, blue = 0;
+            for (int32_t row = 0; row < rowCount; ++row)
+            {
+                for (int32_t column = 0; column < columnCount; ++column)
+                {
+                    const uint8_t* pixel = rows[row] + (((x * 2) + column) * planes);
+                    red += pixel[0];
+                    green += pixel[greenOffset];
+                    blue += pixel[blueOffset];
+                }
+            }
+
+            const int32_t count = rowCount * columnCount;
+            cb[x] = averageChroma(red, green, blue, count, RedToCb, GreenToCb, BlueToCb);
+            cr[x] = averageChroma(red, green, blue, count, RedToCr, GreenToCr, BlueToCr);
+        }
+    }
+
+    return result;
+}
+
+Image YCbCrImage::toRgb() const
+{
+    const auto& tables = chromaTables();
+
+    Image result;
+    result.allocate(y.width, y.height, PixelFormat::RGB8);
+
+    for (uint32_t row = 0; row < y.height; ++row)
+    {
+        const uint8_t* luma = y.row(row);
+        const uint8_t* blueChroma = cb.row(row / 2);
+        const uint8_t* redChroma = cr.row(row / 2);
+        auto* pixels = result.pixels<PixelFormat::RGB8>(row);
+
+        for (uint32_t x = 0; x < y.width; ++x)
+        {
+            const int32_t value = luma[x];
+            const uint8_t blue = blueChroma[x / 2];
+            const uint8_t red = redChroma[x / 2];
+
+            pixels[x].red = clampSample(value + tables.crToRed[red]);
+            pixels[x].green = clampSample(value + ((tables.cbToGreen[blue] + tables.crToGreen[red] + (Scale / 2)) >> 16));
+            pixels[x].blue = clampSample(value + tables.cbToBlue[blue]);
+        }
+    }
+
+    return result;
+}
+
+void YCbCrImage::resizeInto(YCbCrImage& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo) const
+{
+    resizeInto(dst, newWidth, newHeight, algo, ResizeOptions());
+}
+
+void YCbCrImage::resizeInto(YCbCrImage& dst, uint32_t newWidth, uint32_t newHeight, ResizeAlgorithm algo, const ResizeOptions& options) const
+{
+    if (&dst == this)
+    {
+        throw std::runtime_error("Failed to resize image, the destination can not be the source image");
+    }
+
+    ResizeOptions planeOptions = options;
+    planeOptions.linearLight = false;
+    planeOptions.premultiplyAlpha = false;
+
+    y.resizeInto(dst.y, newWidth, newHeight, algo, planeOptions);
+    cb.resizeInto(dst.cb, (newWidth + 1) / 2, (newHeight + 1) / 2, algo, planeOptions);
+    cr.resizeInto(dst.cr, (newWidth + 1) / 2, (newHeight + 1) / 2, algo, planeOptions);
+}
+
+std::unique_ptr<YCbCrImage> loadYCbCrFromMemory(const uint8_t* pData, uint64_t dataSize)
+{
+#if HAVE_JPEG
+    LoadStoreJpeg jpeg;
+    if (jpeg.isValidImageData(pData, dataSize))
+    {
+        return jpeg.loadYCbCrFromMemory(pData, dataSize);
+    }
+#endif
+
+    return std::make_unique<YCbCrImage>(YCbCrImage::fromRgb(*Factory::createFromData(pData, dataSize)));
+}
+
+std::vector<uint8_t> storeYCbCrToJpeg(const YCbCrImage& image)
+{
+#if HAVE_JPEG
+    LoadStoreJpeg jpeg;
+    return jpeg.storeYCbCrToMemory(image);
+#else
+    (void)image;
+    throw std::runtime_error("Library not compiled with jpeg support");
+#endif
+}
+
+}
@@ -17,13 +17,27 @@
 #include <gtest/gtest.h>
 
 #include <array>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <thread>
+#include <cinttypes>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 #include "utils/fileoperations.h"
 
 #include "imageconfig.h"
 #include "imagetestconfig.h"
+#include "image/image.h"
 #include "image/imagefactory.h"
+#include "image/imagerawfile.h"
+#include "image/imagesharedmemory.h"
+#include "image/imagetiled.h"
+#include "image/imageycbcr.h"
 #include "image/imageloadstoreinterface.h"
 
 using namespace utils;
@@ -41,6 +55,8 @@ static const std::string g_corruptData = IMAGE_TEST_DATA_DIR "/corrupt.jpg";
 static const std::string g_cmykData = IMAGE_TEST_DATA_DIR "/cmyk.jpg";
 static const std::string g_rgbaPng = IMAGE_TEST_DATA_DIR "/rgba.png";
 static const std::string g_colormapPng = IMAGE_TEST_DATA_DIR "/colormap.png";
+static const std::string g_palettePng = IMAGE_TEST_DATA_DIR "/palette2bit.png";
+static const std::string g_grayPng = IMAGE_TEST_DATA_DIR "/gray1bit.png";
 static const std::string g_strangeAppMarkerJpg = IMAGE_TEST_DATA_DIR "/appheader.jpg";
 
 static const std::string g_testJpegFile = "imageloadingtestfile.jpg";
@@ -68,6 +84,15 @@ protected:
     }
 };
 
+// Deterministic pixels without large flat areas
+static void fillPattern(Image& image)
+{
+    for (size_t i = 0; i < image.data.size(); ++i)
+    {
+        image.data[i] = static_cast<uint8_t>((i * 7919) >> 3);
+    }
+}
+
 #if HAVE_JPEG
 TEST_F(ImageLoadingTest, dataValidationJpeg)
 {
@@ -142,6 +167,17 @@ TEST_F(ImageLoadingTest, resizeBilinearZoom)
     auto jpegStore = Factory::createLoadStore(Type::Jpeg);
     jpegStore->storeToFile(*image, "ResizedBilinearZoom" + g_testJpegFile);
 }
+
+TEST_F(ImageLoadingTest, resizeLanczosReduction)
+{
+    auto jpegData = fileops::readFile(g_jpegTestData);
+
+    auto image = Factory::createFromData(jpegData);
+    image->resize(180, 120, ResizeAlgorithm::Lanczos3);
+
+    auto jpegStore = Factory::createLoadStore(Type::Jpeg);
+    jpegStore->storeToFile(*image, "ResizedLanczosReduce" + g_testJpegFile);
+}
 #endif
 
 #if HAVE_PNG
@@ -198,5 +234,504 @@ TEST_F(ImageLoadingTest, StoreRGBAPngToJpeg)
 }
 #endif
 
+#if HAVE_JPEG
+static double meanDifference(const Image& a, const Image& b)
+{
+    EXPECT_EQ(a.width, b.width);
+    EXPECT_EQ(a.height, b.height);
+    EXPECT_EQ(a.colorPlanes, b.colorPlanes);
+
+    uint64_t sum = 0;
+    for (uint32_t y = 0; y < a.height; ++y)
+    {
+        for (uint32_t x = 0; x < a.width * a.colorPlanes; ++x)
+        {
+            sum += std::abs(a.row(y)[x] - b.row(y)[x]);
+        }
+    }
+
+    return double(sum) / (a.width * a.height * a.colorPlanes);
+}
+
+TEST_F(ImageLoadingTest, loadScaledJpeg)
+{
+    auto jpegData = fileops::readFile(g_jpegTestData);
+    auto jpegStore = Factory::createLoadStore(Type::Jpeg);
+    auto full = jpegStore->loadFromMemory(jpegData);
+    EXPECT_EQ(1800u, full->width);
+    EXPECT_EQ(1200u, full->height);
+
+    DecodeOptions options;
+    options.scaleDenominator = 2;
+    auto half = jpegStore->loadFromMemory(jpegData.data(), jpegData.size(), options);
+    EXPECT_EQ(900u, half->width);
+    EXPECT_EQ(600u, half->height);
+
+    // the scaled decode is close to a reduction of the full decode
+    Image reduced;
+    full->resizeInto(reduced, 900, 600, ResizeAlgorithm::Area);
+    EXPECT_LT(meanDifference(reduced, *half), 3.0);
+
+    options.scaleDenominator = 3;
+    EXPECT_THROW(jpegStore->loadFromMemory(jpegData.data(), jpegData.size(), options), std::runtime_error);
+
+    // the largest reduction that is still large enough
+    options.minimumWidth = 200;
+    options.minimumHeight = 150;
+    auto thumbnail = Factory::createFromData(jpegData, options);
+    EXPECT_EQ(225u, thumbnail->width);
+    EXPECT_EQ(150u, thumbnail->height);
+
+    options.minimumHeight = 151;
+    thumbnail = Factory::createFromData(jpegData, options);
+    EXPECT_EQ(450u, thumbnail->width);
+
+    options.minimumWidth = 1801;
+    thumbnail = Factory::createFromData(jpegData, options);
+    EXPECT_EQ(1800u, thumbnail->width);
+
+    auto cmykData = fileops::readFile(g_cmykData);
+    auto cmyk = jpegStore->loadFromMemory(cmykData.data(), cmykData.size(), options);
+    auto cmykQuarter = Factory::createFromData(cmykData, DecodeOptions { 4, 0, 0 });
+    EXPECT_EQ((cmyk->width + 3) / 4, cmykQuarter->width);
+    EXPECT_EQ((cmyk->height + 3) / 4, cmykQuarter->height);
+
+    // the options are also passed on when the type is given or the data is read from a file
+    options = DecodeOptions { 2, 0, 0 };
+    half = Factory::createFromUri(g_jpegTestData, options);
+    EXPECT_EQ(900u, half->width);
+    EXPECT_EQ(600u, half->height);
+
+    half = Factory::createFromUri(g_jpegTestData, Type::Jpeg, options);
+    EXPECT_EQ(900u, half->width);
+
+    half = Factory::createFromData(jpegData, Type::Jpeg, options);
+    EXPECT_EQ(600u, half->height);
+
+    // the type is not detected when it is given
+    EXPECT_THROW(Factory::createFromData(jpegData, Type::Png), std::runtime_error);
+}
+
+TEST_F(ImageLoadingTest, loadYCbCrJpeg)
+{
+    auto jpegData = fileops::readFile(g_jpegTestData);
+    auto jpegStore = Factory::createLoadStore(Type::Jpeg);
+
+    auto rgb = jpegStore->loadFromMemory(jpegData);
+    auto ycbcr = loadYCbCrFromMemory(jpegData.data(), jpegData.size());
+    EXPECT_EQ(rgb->width, ycbcr->width());
+    EXPECT_EQ(rgb->height, ycbcr->height());
+    EXPECT_EQ((rgb->width + 1) / 2, ycbcr->cb.width);
+    EXPECT_EQ((rgb->height + 1) / 2, ycbcr->cr.height);
+
+    // the decoder interpolates the chroma samples when converting to rgb
+    EXPECT_LT(meanDifference(*rgb, ycbcr->toRgb()), 2.0);
+
+    // cmyk data is converted
+    auto cmykData = fileops::readFile(g_cmykData);
+    auto cmyk = loadYCbCrFromMemory(cmykData.data(), cmykData.size());
+    EXPECT_EQ(279u, cmyk->cb.width);
+}
+
+TEST_F(ImageLoadingTest, storeYCbCrJpeg)
+{
+    auto jpegData = fileops::readFile(g_jpegTestData);
+    auto image = loadYCbCrFromMemory(jpegData.data(), jpegData.size());
+
+    YCbCrImage resized;
+    image->resizeInto(resized, 37, 21, ResizeAlgorithm::Area);
+    EXPECT_EQ(19u, resized.cb.width);
+    EXPECT_EQ(11u, resized.cr.height);
+
+    for (auto* source : { image.get(), &resized })
+    {
+        auto stored = storeYCbCrToJpeg(*source);
+        auto reloaded = loadYCbCrFromMemory(stored.data(), stored.size());
+        // lossy compression, the small image has relatively more detail
+        EXPECT_LT(meanDifference(source->y, reloaded->y), 8.0);
+        EXPECT_LT(meanDifference(source->cb, reloaded->cb), 8.0);
+        EXPECT_LT(meanDifference(source->cr, reloaded->cr), 8.0);
+    }
+}
+#endif
+
+TEST_F(ImageLoadingTest, storeTiledImage)
+{
+    Image image;
+    image.allocate(301, 97, PixelFormat::RGBA8);
+    fillPattern(image);
+
+    const auto tiled = TiledImage::fromImage(image, 64);
+
+#if HAVE_JPEG
+    auto jpegStore = Factory::createLoadStore(Type::Jpeg);
+    EXPECT_EQ(jpegStore->storeToMemory(image), storeToMemory(*jpegStore, tiled));
+#endif
+
+#if HAVE_PNG
+    auto pngStore = Factory::createLoadStore(Type::Png);
+    EXPECT_EQ(pngStore->storeToMemory(image), storeToMemory(*pngStore, tiled));
+#endif
+}
+
+TEST_F(ImageLoadingTest, convertYCbCr)
+{
+    // every 2x2 block has a single color, so the conversion only rounds
+    Image image;
+    image.allocate(6, 3, PixelFormat::RGB8);
+    for (uint32_t y = 0; y < 3; ++y)
+    {
+        for (uint32_t x = 0; x < 6; ++x)
+        {
+            auto& pixel = image.pixels<PixelFormat::RGB8>(y)[x];
+            pixel.red = static_cast<uint8_t>(40 * (x / 2) + 20 * (y / 2));
+            pixel.green = static_cast<uint8_t>(200 - 60 * (x / 2));
+            pixel.blue = static_cast<uint8_t>(255 - 100 * (y / 2));
+        }
+    }
+
+    auto ycbcr = YCbCrImage::fromRgb(image);
+    EXPECT_EQ(3u, ycbcr.cb.width);
+    EXPECT_EQ(2u, ycbcr.cb.height);
+
+    auto rgb = ycbcr.toRgb();
+    for (uint32_t y = 0; y < 3; ++y)
+    {
+        for (uint32_t x = 0; x < 6 * 3; ++x)
+        {
+            EXPECT_NEAR(image.row(y)[x], rgb.row(y)[x], 2) << "Mismatch at " << x << ", " << y;
+        }
+    }
+
+    Image gray;
+    gray.allocate(1, 1, PixelFormat::Gray8);
+    gray.data[0] = 77;
+    auto grayYCbCr = YCbCrImage::fromRgb(gray);
+    EXPECT_EQ(77, grayYCbCr.y.data[0]);
+    EXPECT_EQ(128, grayYCbCr.cb.data[0]);
+    EXPECT_EQ(128, grayYCbCr.cr.data[0]);
+}
+
+#if HAVE_PNG
+TEST_F(ImageLoadingTest, loadPalettePngFormats)
+{
+    // the transparency chunk adds an alpha channel
+    auto colormap = Factory::createFromUri(g_colormapPng);
+    EXPECT_EQ(PixelFormat::RGBA8, colormap->format());
+
+    auto palette = Factory::createFromUri(g_palettePng);
+    ASSERT_EQ(PixelFormat::RGB8, palette->format());
+    EXPECT_EQ(4u * 2u * 3u, palette->data.size());
+
+    const auto* pixels = palette->pixels<PixelFormat::RGB8>(1);
+    EXPECT_EQ(255, pixels[0].red);
+    EXPECT_EQ(255, pixels[0].blue);
+    EXPECT_EQ(255, pixels[2].green);
+    EXPECT_EQ(0, pixels[2].red);
+    EXPECT_EQ(255, pixels[3].red);
+    EXPECT_THROW(palette->pixels<PixelFormat::RGBA8>(0), std::runtime_error);
+}
+
+TEST_F(ImageLoadingTest, loadLowBitDepthGrayPng)
+{
+    auto image = Factory::createFromUri(g_grayPng);
+    ASSERT_EQ(PixelFormat::Gray8, image->format());
+    EXPECT_EQ(std::vector<uint8_t>({ 255, 0, 255, 255, 0, 0, 0, 0 }), image->data);
+}
+#endif
+
+#ifndef _WIN32
+static size_t g_allocatedPixels = 0;
+static size_t g_releasedPixels = 0;
+
+static void* countingAllocate(size_t size, size_t alignment)
+{
+    void* memory = nullptr;
+    if (posix_memalign(&memory, alignment, size) != 0)
+    {
+        throw std::bad_alloc();
+    }
+
+    g_allocatedPixels += size;
+    return memory;
+}
+
+static void countingDeallocate(void* memory, size_t size, size_t /*alignment*/)
+{
+    g_releasedPixels += size;
+    free(memory);
+}
+#endif
+
+#if HAVE_PNG and !defined(_WIN32)
+TEST_F(ImageLoadingTest, decodedPixelsAreAligned)
+{
+    auto image = Factory::createFromUri(g_rgbaPng);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(image->data.data()) % PixelAlignment);
+
+    setPixelHugePages(true);
+    PixelData large(4 * 1024 * 1024);
+    setPixelHugePages(false);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(large.data()) % PixelAlignment);
+}
+
+TEST_F(ImageLoadingTest, decodeUsesCustomPixelAllocator)
+{
+    g_allocatedPixels = 0;
+    g_releasedPixels = 0;
+    setPixelAllocator(countingAllocate, countingDeallocate);
+
+    {
+        auto image = Factory::createFromUri(g_rgbaPng);
+        EXPECT_EQ(image->data.size(), g_allocatedPixels);
+        EXPECT_EQ(0u, g_releasedPixels);
+    }
+
+    setPixelAllocator(nullptr, nullptr);
+    EXPECT_EQ(g_allocatedPixels, g_releasedPixels);
+}
+#endif
+
+#ifdef __linux__
+static bool isMappedPixelFile(const void* memory)
+{
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line))
+    {
+        uintptr_t begin = 0, end = 0;
+        if (sscanf(line.c_str(), "%" SCNxPTR "-%" SCNxPTR, &begin, &end) == 2 &&
+            reinterpret_cast<uintptr_t>(memory) >= begin && reinterpret_cast<uintptr_t>(memory) < end)
+        {
+            return line.find("imagepixels") != std::string::npos;
+        }
+    }
+
+    return false;
+}
+
+TEST_F(ImageLoadingTest, fileBackedPixels)
+{
+    Image image;
+    image.allocate(1000, 500, PixelFormat::RGB8);
+    fillPattern(image);
+
+    Image expected;
+    image.resizeInto(expected, 1200, 700, ResizeAlgorithm::Bicubic);
+    EXPECT_FALSE(isMappedPixelFile(expected.data.data()));
+
+    setPixelFileBacking(".", 1024 * 1024);
+    {
+        auto mapped = image.clone();
+        EXPECT_TRUE(isMappedPixelFile(mapped.data.data()));
+        EXPECT_EQ(image.data, mapped.data);
+
+        Image result;
+        mapped.resizeInto(result, 1200, 700, ResizeAlgorithm::Bicubic);
+        EXPECT_TRUE(isMappedPixelFile(result.data.data()));
+        EXPECT_EQ(expected.data, result.data);
+
+        // small buffers stay in memory
+        Image small;
+        mapped.resizeInto(small, 100, 50, ResizeAlgorithm::Bicubic);
+        EXPECT_FALSE(isMappedPixelFile(small.data.data()));
+
+        // released buffers are unmapped even when the file backing is disabled
+        setPixelFileBacking("");
+    }
+
+    setPixelFileBacking("/nonexistent/directory", 1);
+    EXPECT_THROW(image.clone(), std::runtime_error);
+    setPixelFileBacking("");
+}
+
+TEST_F(ImageLoadingTest, sharedMemoryImage)
+{
+    Image image;
+    image.allocate(57, 31, PixelFormat::RGBA8);
+    fillPattern(image);
+
+    auto shared = SharedMemoryImage::create(40, 20, PixelFormat::RGBA8);
+    EXPECT_TRUE(shared.writable());
+    image.resizeInto(shared.row(0), shared.header().stride, 40, 20, ResizeAlgorithm::Bilinear);
+
+    // the receiver can not trust memory the sender can still modify
+    EXPECT_THROW(SharedMemoryImage::import(dup(shared.fd()), shared.header()), std::runtime_error);
+
+    // sealing fails while another writable mapping exists, the image remains writable
+    const size_t size = size_t(shared.header().stride) * 20;
+    auto* mapping = static_cast<uint8_t*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, shared.fd(), 0));
+    ASSERT_NE(MAP_FAILED, static_cast<void*>(mapping));
+    EXPECT_THROW(shared.seal(), std::runtime_error);
+    EXPECT_TRUE(shared.writable());
+    shared.row(0)[0] ^= 0xFF;
+    EXPECT_EQ(shared.row(0)[0], mapping[0]);
+    shared.row(0)[0] ^= 0xFF;
+    munmap(mapping, size);
+
+    shared.seal();
+    EXPECT_FALSE(shared.writable());
+    EXPECT_THROW(shared.row(0), std::runtime_error);
+
+    // the descriptor would normally be sent to another process
+    auto imported = SharedMemoryImage::import(dup(shared.fd()), shared.header());
+    EXPECT_EQ(PixelFormat::RGBA8, imported.format());
+    EXPECT_THROW(imported.row(0), std::runtime_error);
+
+    Image expected;
+    image.resizeInto(expected, 40, 20, ResizeAlgorithm::Bilinear);
+
+    const auto view = imported.view();
+    EXPECT_NE(shared.view().data, view.data);
+    for (uint32_t y = 0; y < 20; ++y)
+    {
+        EXPECT_TRUE(std::equal(expected.row(y), expected.row(y) + (40 * 4), view.row(y)));
+    }
+
+    auto header = shared.header();
+    header.height = 21;
+    EXPECT_THROW(SharedMemoryImage::import(dup(shared.fd()), header), std::runtime_error);
+    header.height = 20;
+    header.format = 42;
+    EXPECT_THROW(SharedMemoryImage::import(dup(shared.fd()), header), std::runtime_error);
+}
+#endif
+
+#ifndef _WIN32
+TEST_F(ImageLoadingTest, rawImageFile)
+{
+    const std::string path = "imageloadingtestfile.raw";
+
+    Image image;
+    image.allocate(57, 31, PixelFormat::RGB16);
+    fillPattern(image);
+
+    RawImageFile::storeToFile(image.crop(3, 1, 50, 30), path);
+
+    {
+        auto file = RawImageFile::loadFromFile(path);
+        EXPECT_TRUE(file.verify());
+        EXPECT_EQ(PixelFormat::RGB16, file.format());
+
+        const auto view = file.view();
+        EXPECT_EQ(50u, view.width);
+        EXPECT_EQ(30u, view.height);
+        EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(view.data) % PixelAlignment);
+        for (uint32_t y = 0; y < 30; ++y)
+        {
+            EXPECT_TRUE(std::equal(view.row(y), view.row(y) + (50 * 6), image.row(y + 1) + (3 * 6)));
+        }
+    }
+
+    auto data = fileops::readFile(path);
+    data[5000] ^= 1;
+    fileops::writeFile(data, path);
+    EXPECT_FALSE(RawImageFile::loadFromFile(path).verify());
+
+    data.resize(data.size() - 1);
+    fileops::writeFile(data, path);
+    EXPECT_THROW(RawImageFile::loadFromFile(path), std::runtime_error);
+
+    data[0] = 'X';
+    fileops::writeFile(data, path);
+    EXPECT_THROW(RawImageFile::loadFromFile(path), std::runtime_error);
+
+    // every writer of the path uses its own temporary file
+    std::thread writer([&] () { RawImageFile::storeToFile(image, path); });
+    RawImageFile::storeToFile(image, path);
+    writer.join();
+    EXPECT_TRUE(RawImageFile::loadFromFile(path).verify());
+    EXPECT_THROW(RawImageFile::storeToFile(image, "/nonexistent/directory/image.raw"), std::runtime_error);
+
+    fileops::deleteFile(path);
+    EXPECT_THROW(RawImageFile::loadFromFile(path), std::runtime_error);
+}
+#endif
+
+#ifndef _WIN32
+TEST_F(ImageLoadingTest, pixelPoolRecyclesBuffers)
+{
+    g_allocatedPixels = 0;
+    g_releasedPixels = 0;
+    setPixelAllocator(countingAllocate, countingDeallocate);
+    setPixelPoolCapacity(16 * 1024 * 1024);
+
+    {
+        Image image;
+        image.allocate(1000, 500, PixelFormat::RGB8);
+        EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(image.data.data()) % PixelAlignment);
+    }
+
+    auto stats = pixelPoolStatistics();
+    EXPECT_EQ(0u, stats.hits);
+    EXPECT_EQ(1u, stats.misses);
+    EXPECT_GE(stats.retainedBytes, 1000u * 500u * 3u);
+    EXPECT_EQ(0u, g_releasedPixels);
+    const auto allocated = g_allocatedPixels;
+
+    {
+        // a slightly smaller image fits in the same bucket
+        Image image;
+        image.allocate(990, 500, PixelFormat::RGB8);
+        EXPECT_EQ(allocated, g_allocatedPixels);
+        EXPECT_EQ(0u, pixelPoolStatistics().retainedBytes);
+
+        image.resize(500, 250, ResizeAlgorithm::Area);
+    }
+
+    stats = pixelPoolStatistics();
+    EXPECT_EQ(1u, stats.hits);
+    EXPECT_EQ(2u, stats.misses);
+    EXPECT_EQ(0u, g_releasedPixels);
+
+    // buffers that do not fit are released
+    setPixelPoolCapacity(stats.retainedBytes - 1);
+    EXPECT_EQ(0u, pixelPoolStatistics().retainedBytes);
+    EXPECT_EQ(g_allocatedPixels, g_releasedPixels);
+
+    setPixelPoolCapacity(0);
+    setPixelAllocator(nullptr, nullptr);
+}
+
+TEST_F(ImageLoadingTest, pixelPoolEnabledWhileBuffersAreInUse)
+{
+    g_allocatedPixels = 0;
+    g_releasedPixels = 0;
+    setPixelAllocator(countingAllocate, countingDeallocate);
+
+    const auto hits = pixelPoolStatistics().hits;
+
+    {
+        // allocated while the pool is disabled with its exact size, it is not retained once the pool
+        // is enabled because it is smaller than its bucket
+        PixelData before(100000);
+        EXPECT_EQ(100000u, g_allocatedPixels);
+        setPixelPoolCapacity(16 * 1024 * 1024);
+    }
+
+    EXPECT_EQ(100000u, g_releasedPixels);
+    EXPECT_EQ(0u, pixelPoolStatistics().retainedBytes);
+
+    {
+        PixelData pooled(100000);
+    }
+
+    EXPECT_LT(0u, pixelPoolStatistics().retainedBytes);
+
+    {
+        // reuses the retained buffer, which has to be large enough for the complete bucket
+        PixelData reused(110000);
+        EXPECT_EQ(hits + 1, pixelPoolStatistics().hits);
+        std::fill(reused.begin(), reused.end(), uint8_t(1));
+
+        // released while the pool is disabled, with the size it was allocated with
+        setPixelPoolCapacity(0);
+    }
+
+    EXPECT_EQ(g_allocatedPixels, g_releasedPixels);
+    setPixelAllocator(nullptr, nullptr);
+}
+#endif
+
 }
 }
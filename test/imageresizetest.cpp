@@ -0,0 +1,1094 @@
+//    Copyright (C) 2018 Dirk Vanden Boer <dirk.vdb@gmail.com>
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+#include "utils/fileoperations.h"
+
+#include "imageconfig.h"
+#include "imagetestconfig.h"
+#include "image/image.h"
+#include "image/imagefactory.h"
+#include "image/imageloadstoreinterface.h"
+#include "image/imageresizeplan.h"
+#include "image/imagepyramid.h"
+#include "image/imageshared.h"
+#include "image/imagetiled.h"
+#include "image/imagesimd.h"
+
+using namespace utils;
+using namespace testing;
+
+namespace image
+{
+namespace test
+{
+
+static const std::string g_jpegTestData = IMAGE_TEST_DATA_DIR "/frog.jpg";
+static const std::string g_jpegSmallTestData = IMAGE_TEST_DATA_DIR "/frogsmall.jpg";
+static const std::string g_rgbaPng = IMAGE_TEST_DATA_DIR "/rgba.png";
+
+class ImageResizeTest : public Test
+{
+protected:
+    static Image createImage(uint32_t width, uint32_t height, uint32_t planes, uint32_t bitDepth = 8)
+    {
+        Image image;
+        image.width = width;
+        image.height = height;
+        image.bitDepth = bitDepth;
+        image.colorPlanes = planes;
+        image.data.assign(width * height * planes * (bitDepth / 8), 0);
+        return image;
+    }
+
+    // every channel gets a different value, so mixed up channels are detected
+    template <typename Sample>
+    static Image createFlatImage(uint32_t width, uint32_t height, uint32_t planes)
+    {
+        auto image = createImage(width, height, planes, sizeof(Sample) * 8);
+        auto* samples = reinterpret_cast<Sample*>(image.data.data());
+        for (uint32_t i = 0; i < width * height * planes; ++i)
+        {
+            samples[i] = flatValue<Sample>(i % planes);
+        }
+
+        return image;
+    }
+
+    template <typename Sample>
+    static Sample flatValue(uint32_t channel)
+    {
+        return static_cast<Sample>((std::numeric_limits<Sample>::max() / 5) * (channel + 1));
+    }
+
+    template <typename Sample>
+    static void expectFlatImage(const Image& image)
+    {
+        auto* samples = reinterpret_cast<const Sample*>(image.data.data());
+        for (uint32_t i = 0; i < image.width * image.height * image.colorPlanes; ++i)
+        {
+            ASSERT_EQ(flatValue<Sample>(i % image.colorPlanes), samples[i]) << "Mismatch at sample " << i;
+        }
+    }
+
+    static Image createCheckerboard(uint32_t width, uint32_t height)
+    {
+        auto image = createImage(width, height, 3);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                auto* pixel = &image.data[((y * width) + x) * 3];
+                pixel[0] = pixel[1] = pixel[2] = ((x + y) % 2) ? 255 : 0;
+            }
+        }
+
+        return image;
+    }
+
+    void TearDown()
+    {
+        setSimdLevel(detectSimdLevel());
+        setRowAlignment(1);
+    }
+
+    static std::unique_ptr<Image> resizeWithLevel(const std::vector<uint8_t>& imageData, uint32_t width, uint32_t height, ResizeAlgorithm algo, SimdLevel level)
+    {
+        setSimdLevel(level);
+
+        auto image = Factory::createFromData(imageData);
+        image->resize(width, height, algo);
+        return image;
+    }
+
+    static void expectSimdMatchesScalar(const std::vector<uint8_t>& imageData, uint32_t width, uint32_t height)
+    {
+        auto reference = resizeWithLevel(imageData, width, height, ResizeAlgorithm::Bilinear, SimdLevel::None);
+
+        for (auto level : { SimdLevel::Sse41, SimdLevel::Avx2 })
+        {
+            if (level > detectSimdLevel())
+            {
+                continue;
+            }
+
+            auto image = resizeWithLevel(imageData, width, height, ResizeAlgorithm::Bilinear, level);
+            EXPECT_EQ(reference->data, image->data) << "Mismatch for level " << static_cast<int>(level);
+        }
+    }
+};
+
+static const ResizeAlgorithm g_allAlgorithms[] = {
+    ResizeAlgorithm::NearestNeighbor, ResizeAlgorithm::Bilinear,
+    ResizeAlgorithm::Bicubic, ResizeAlgorithm::Mitchell, ResizeAlgorithm::Lanczos3,
+    ResizeAlgorithm::Area
+};
+
+static const ResizeAlgorithm g_filterAlgorithms[] = { ResizeAlgorithm::Bicubic, ResizeAlgorithm::Mitchell, ResizeAlgorithm::Lanczos3 };
+
+TEST_F(ImageResizeTest, pixelFormats)
+{
+    for (auto format : { PixelFormat::Gray8, PixelFormat::GrayA8, PixelFormat::RGB8, PixelFormat::RGBA8,
+                         PixelFormat::Gray16, PixelFormat::GrayA16, PixelFormat::RGB16, PixelFormat::RGBA16 })
+    {
+        EXPECT_EQ(format, pixelFormat(colorPlanesOf(format), bitDepthOf(format)));
+        EXPECT_EQ(colorPlanesOf(format) * bitDepthOf(format) / 8, pixelSizeOf(format));
+    }
+
+    EXPECT_TRUE(hasAlpha(PixelFormat::GrayA16));
+    EXPECT_FALSE(hasAlpha(PixelFormat::RGB8));
+    EXPECT_THROW(pixelFormat(5, 8), std::runtime_error);
+    EXPECT_THROW(pixelFormat(3, 12), std::runtime_error);
+
+    Image image;
+    image.allocate(3, 2, PixelFormat::RGBA16);
+    EXPECT_EQ(4u, image.colorPlanes);
+    EXPECT_EQ(16u, image.bitDepth);
+
+    image.pixels<PixelFormat::RGBA16>(1)[2].alpha = 0xABCD;
+    EXPECT_EQ(0xABCD, reinterpret_cast<const uint16_t*>(image.row(1))[11]);
+    EXPECT_EQ(0xABCD, ImageView(image).pixels<PixelFormat::RGBA16>(1)[2].alpha);
+    EXPECT_THROW(image.pixels<PixelFormat::RGBA8>(0), std::runtime_error);
+}
+
+TEST_F(ImageResizeTest, resizeAllChannelCounts)
+{
+    for (uint32_t planes = 1; planes <= 4; ++planes)
+    {
+        for (auto algo : g_allAlgorithms)
+        {
+            auto image = createFlatImage<uint8_t>(67, 45, planes);
+            image.resize(30, 20, algo);
+            EXPECT_EQ(30u * 20u * planes, image.data.size());
+            expectFlatImage<uint8_t>(image);
+
+            image.resize(101, 83, algo);
+            expectFlatImage<uint8_t>(image);
+        }
+    }
+}
+
+TEST_F(ImageResizeTest, resize16BitImages)
+{
+    for (uint32_t planes = 1; planes <= 4; ++planes)
+    {
+        for (auto algo : g_allAlgorithms)
+        {
+            auto image = createFlatImage<uint16_t>(67, 45, planes);
+            image.resize(30, 20, algo);
+            EXPECT_EQ(30u * 20u * planes * 2u, image.data.size());
+            expectFlatImage<uint16_t>(image);
+
+            image.resize(101, 83, algo);
+            expectFlatImage<uint16_t>(image);
+        }
+    }
+}
+
+TEST_F(ImageResizeTest, bilinear16BitUsesFullRange)
+{
+    auto image = createImage(2, 1, 1, 16);
+    auto* samples = reinterpret_cast<uint16_t*>(image.data.data());
+    samples[0] = 0;
+    samples[1] = 65535;
+
+    image.resize(4, 1, ResizeAlgorithm::Bilinear);
+    samples = reinterpret_cast<uint16_t*>(image.data.data());
+    EXPECT_EQ(0, samples[1]);
+    EXPECT_EQ(32768, samples[2]);
+    EXPECT_EQ(65535, samples[3]);
+}
+
+TEST_F(ImageResizeTest, unsupportedBitDepthThrows)
+{
+    auto image = createImage(8, 8, 3, 8);
+    image.bitDepth = 4;
+    EXPECT_THROW(image.resize(4, 4, ResizeAlgorithm::Bilinear), std::runtime_error);
+}
+
+TEST_F(ImageResizeTest, bilinearFixedPointWeights)
+{
+    auto image = createImage(2, 1, 3);
+    std::fill(image.data.begin() + 3, image.data.end(), 255);
+
+    image.resize(4, 1, ResizeAlgorithm::Bilinear);
+    EXPECT_EQ(std::vector<uint8_t>({ 0, 0, 0, 0, 0, 0, 128, 128, 128, 255, 255, 255 }), image.data);
+}
+
+TEST_F(ImageResizeTest, areaAveragesCoveredPixels)
+{
+    auto image = createImage(4, 2, 1);
+    image.data = { 0, 10, 100, 200, 20, 30, 40, 60 };
+
+    image.resize(2, 1, ResizeAlgorithm::Area);
+    EXPECT_EQ(std::vector<uint8_t>({ 15, 100 }), image.data);
+}
+
+TEST_F(ImageResizeTest, areaFractionalCoverage)
+{
+    // every destination pixel covers 1.5 source pixels
+    auto image = createImage(3, 1, 1);
+    image.data = { 0, 90, 180 };
+
+    image.resize(2, 1, ResizeAlgorithm::Area);
+    EXPECT_EQ(std::vector<uint8_t>({ 30, 150 }), image.data);
+}
+
+TEST_F(ImageResizeTest, areaLargeReductionDoesNotAlias)
+{
+    auto image = createCheckerboard(500, 500);
+    image.resize(64, 64, ResizeAlgorithm::Area);
+
+    for (auto value : image.data)
+    {
+        ASSERT_NEAR(128, value, 2);
+    }
+}
+
+TEST_F(ImageResizeTest, areaPowerOfTwoReductions)
+{
+    for (uint32_t planes = 1; planes <= 4; ++planes)
+    {
+        for (uint32_t factor : { 2u, 4u, 8u })
+        {
+            const uint32_t width = 37;
+            const uint32_t height = 11;
+
+            auto image = createImage(width * factor, height * factor, planes);
+            for (size_t i = 0; i < image.data.size(); ++i)
+            {
+                image.data[i] = static_cast<uint8_t>((i * 7919) >> 3);
+            }
+
+            std::vector<uint8_t> expected;
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                for (uint32_t x = 0; x < width * planes; ++x)
+                {
+                    uint32_t sum = 0;
+                    for (uint32_t i = 0; i < factor * factor; ++i)
+                    {
+                        const uint32_t row = (y * factor) + (i / factor);
+                        const uint32_t column = (((x / planes) * factor) + (i % factor)) * planes + (x % planes);
+                        sum += image.data[(row * width * factor * planes) + column];
+                    }
+
+                    expected.push_back(static_cast<uint8_t>((sum + (factor * factor / 2)) / (factor * factor)));
+                }
+            }
+
+            for (auto level : { SimdLevel::None, SimdLevel::Sse41, SimdLevel::Avx2 })
+            {
+                setSimdLevel(level);
+
+                Image reduced;
+                image.resizeInto(reduced, width, height, ResizeAlgorithm::Area);
+                EXPECT_EQ(expected, reduced.data) << "Mismatch for " << planes << " planes, factor " << factor << ", level " << static_cast<int>(level);
+            }
+        }
+    }
+}
+
+TEST_F(ImageResizeTest, filterKeepsFlatAreasFlat)
+{
+    for (auto algo : g_filterAlgorithms)
+    {
+        auto image = createImage(200, 100, 3);
+        std::fill(image.data.begin(), image.data.end(), 87);
+
+        image.resize(37, 23, algo);
+        EXPECT_EQ(37u, image.width);
+        EXPECT_EQ(23u, image.height);
+        EXPECT_EQ(37u * 23u * 3u, image.data.size());
+        for (auto value : image.data)
+        {
+            ASSERT_EQ(87, value);
+        }
+
+        image.resize(211, 97, algo);
+        for (auto value : image.data)
+        {
+            ASSERT_EQ(87, value);
+        }
+    }
+}
+
+TEST_F(ImageResizeTest, filterLargeReductionDoesNotAlias)
+{
+    for (auto algo : g_filterAlgorithms)
+    {
+        auto image = createCheckerboard(400, 400);
+        image.resize(20, 20, algo);
+
+        for (auto value : image.data)
+        {
+            ASSERT_NEAR(128, value, 3);
+        }
+    }
+}
+
+TEST_F(ImageResizeTest, linearLightKeepsFlatAreasFlat)
+{
+    ResizeOptions options;
+    options.linearLight = true;
+
+    for (uint32_t planes = 1; planes <= 4; ++planes)
+    {
+        for (auto algo : g_allAlgorithms)
+        {
+            auto image = createFlatImage<uint8_t>(67, 45, planes);
+            image.resize(30, 20, algo, options);
+            expectFlatImage<uint8_t>(image);
+
+            image.resize(101, 83, algo, options);
+            expectFlatImage<uint8_t>(image);
+        }
+    }
+}
+
+TEST_F(ImageResizeTest, linearLightConvertsEveryValueBackUnchanged)
+{
+    ResizeOptions options;
+    options.linearLight = true;
+
+    auto image = createImage(256, 2, 1);
+    for (uint32_t i = 0; i < 512; ++i)
+    {
+        image.data[i] = static_cast<uint8_t>(i);
+    }
+
+    Image result;
+    image.resizeInto(result, 256, 1, ResizeAlgorithm::NearestNeighbor, options);
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        EXPECT_EQ(i, result.data[i]);
+    }
+}
+
+TEST_F(ImageResizeTest, linearLightBlendsLinearValues)
+{
+    ResizeOptions options;
+    options.linearLight = true;
+
+    // black and white pixels, the alpha channel is blended without gamma conversion
+    auto image = createImage(2, 1, 4);
+    image.data = { 0, 0, 0, 0, 255, 255, 255, 255 };
+
+    Image encoded;
+    image.resizeInto(encoded, 1, 1, ResizeAlgorithm::Area);
+    EXPECT_EQ(std::vector<uint8_t>({ 128, 128, 128, 128 }), encoded.data);
+
+    Image linear;
+    image.resizeInto(linear, 1, 1, ResizeAlgorithm::Area, options);
+    EXPECT_EQ(std::vector<uint8_t>({ 188, 188, 188, 128 }), linear.data);
+}
+
+TEST_F(ImageResizeTest, premultipliedAlphaDoesNotBleedTransparentColor)
+{
+    ResizeOptions options;
+    options.premultiplyAlpha = true;
+
+    // opaque red next to transparent green
+    auto image = createImage(2, 1, 4);
+    image.data = { 255, 0, 0, 255, 0, 255, 0, 0 };
+
+    Image straight;
+    image.resizeInto(straight, 1, 1, ResizeAlgorithm::Area);
+    EXPECT_EQ(std::vector<uint8_t>({ 128, 128, 0, 128 }), straight.data);
+
+    Image premultiplied;
+    image.resizeInto(premultiplied, 1, 1, ResizeAlgorithm::Area, options);
+    EXPECT_EQ(std::vector<uint8_t>({ 255, 0, 0, 128 }), premultiplied.data);
+
+    options.linearLight = true;
+    Image linear;
+    image.resizeInto(linear, 1, 1, ResizeAlgorithm::Area, options);
+    EXPECT_EQ(std::vector<uint8_t>({ 255, 0, 0, 128 }), linear.data);
+
+    auto image16 = createImage(2, 1, 2, 16);
+    auto* samples = reinterpret_cast<uint16_t*>(image16.data.data());
+    samples[0] = 1000; samples[1] = 65535;
+    samples[2] = 65535; samples[3] = 0;
+
+    Image premultiplied16;
+    image16.resizeInto(premultiplied16, 1, 1, ResizeAlgorithm::Area, options);
+    auto* result = reinterpret_cast<const uint16_t*>(premultiplied16.data.data());
+    EXPECT_EQ(1000, result[0]);
+    EXPECT_EQ(32768, result[1]);
+}
+
+TEST_F(ImageResizeTest, premultipliedAlphaSimdMatchesScalar)
+{
+    ResizeOptions options;
+    options.premultiplyAlpha = true;
+
+    auto image = createImage(157, 61, 4);
+    for (size_t i = 0; i < image.data.size(); ++i)
+    {
+        image.data[i] = static_cast<uint8_t>((i * 7919) >> 3);
+    }
+
+    for (auto algo : g_allAlgorithms)
+    {
+        setSimdLevel(SimdLevel::None);
+        Image reference;
+        image.resizeInto(reference, 67, 43, algo, options);
+
+        for (auto level : { SimdLevel::Sse41, SimdLevel::Avx2 })
+        {
+            setSimdLevel(level);
+
+            Image reduced;
+            image.resizeInto(reduced, 67, 43, algo, options);
+            EXPECT_EQ(reference.data, reduced.data) << "Mismatch for algorithm " << static_cast<int>(algo) << ", level " << static_cast<int>(level);
+        }
+    }
+}
+
+TEST_F(ImageResizeTest, resizePlanMatchesImageResize)
+{
+    for (auto algo : g_allAlgorithms)
+    {
+        const ResizePlan plan(211, 97, 64, 48, algo, 3);
+        EXPECT_EQ(211u, plan.sourceWidth());
+        EXPECT_EQ(48u, plan.targetHeight());
+        EXPECT_EQ(algo, plan.algorithm());
+
+        for (uint32_t seed = 1; seed <= 3; ++seed)
+        {
+            auto image = createImage(211, 97, 3);
+            for (size_t i = 0; i < image.data.size(); ++i)
+            {
+                image.data[i] = static_cast<uint8_t>((i * seed * 2654435761u) >> 13);
+            }
+
+            Image reference;
+            image.resizeInto(reference, 64, 48, algo);
+
+            Image result;
+            plan.run(image, result);
+            EXPECT_EQ(64u, result.width);
+            EXPECT_EQ(48u, result.height);
+            EXPECT_EQ(3u, result.colorPlanes);
+            EXPECT_EQ(reference.data, result.data);
+        }
+    }
+}
+
+TEST_F(ImageResizeTest, resizePlanIsSharedBetweenThreads)
+{
+    const ResizePlan plan(300, 200, 75, 50, ResizeAlgorithm::Lanczos3, 4);
+
+    std::vector<Image> images;
+    std::vector<Image> references(8);
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        images.push_back(createImage(300, 200, 4));
+        std::fill(images[i].data.begin(), images[i].data.end(), static_cast<uint8_t>(i * 31));
+        plan.run(images[i], references[i]);
+    }
+
+    std::vector<Image> results(8);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        threads.emplace_back([&, i] () {
+            plan.run(images[i], results[i]);
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        EXPECT_EQ(references[i].data, results[i].data);
+    }
+}
+
+TEST_F(ImageResizeTest, resizePlanRejectsMismatchingImages)
+{
+    EXPECT_THROW(ResizePlan(0, 10, 5, 5, ResizeAlgorithm::Bilinear, 3), std::runtime_error);
+    EXPECT_THROW(ResizePlan(10, 10, 5, 5, ResizeAlgorithm::Bilinear, 5), std::runtime_error);
+
+    const ResizePlan plan(100, 80, 50, 40, ResizeAlgorithm::Bilinear, 3);
+    Image result;
+
+    auto wrongSize = createImage(101, 80, 3);
+    EXPECT_THROW(plan.run(wrongSize, result), std::runtime_error);
+
+    auto wrongPlanes = createImage(100, 80, 4);
+    EXPECT_THROW(plan.run(wrongPlanes, result), std::runtime_error);
+
+    auto image = createImage(100, 80, 3);
+    std::vector<uint8_t> buffer(50 * 40 * 3);
+    EXPECT_THROW(plan.run(image, buffer.data(), 50 * 3 - 1), std::runtime_error);
+    EXPECT_NO_THROW(plan.run(image, buffer.data(), 50 * 3));
+}
+
+#if HAVE_JPEG
+TEST_F(ImageResizeTest, resizeHonorsSourceStride)
+{
+    auto image = createImage(93, 41, 3);
+    for (size_t i = 0; i < image.data.size(); ++i)
+    {
+        image.data[i] = static_cast<uint8_t>((i * 7919) >> 3);
+    }
+
+    // the same pixels with padded rows
+    auto padded = createImage(93, 41, 3);
+    padded.stride = (93 * 3) + 13;
+    padded.data.assign(padded.stride * 41, 0xAB);
+    for (uint32_t y = 0; y < 41; ++y)
+    {
+        std::copy(image.row(y), image.row(y) + (93 * 3), padded.row(y));
+    }
+
+    for (auto algo : g_allAlgorithms)
+    {
+        Image expected;
+        image.resizeInto(expected, 50, 67, algo);
+
+        Image result;
+        padded.resizeInto(result, 50, 67, algo);
+        EXPECT_EQ(expected.data, result.data) << "Mismatch for algorithm " << static_cast<int>(algo);
+    }
+
+    EXPECT_EQ(ImagePyramid(image).image(0).data, ImagePyramid(padded).image(0).data);
+
+    padded.stride = (93 * 3) - 1;
+    Image result;
+    EXPECT_THROW(padded.resizeInto(result, 50, 67, ResizeAlgorithm::Bilinear), std::runtime_error);
+}
+
+TEST_F(ImageResizeTest, resizeCroppedView)
+{
+    auto image = createImage(93, 41, 4);
+    for (size_t i = 0; i < image.data.size(); ++i)
+    {
+        image.data[i] = static_cast<uint8_t>((i * 7919) >> 3);
+    }
+
+    // copy of the region
+    auto region = createImage(30, 20, 4);
+    for (uint32_t y = 0; y < 20; ++y)
+    {
+        std::copy(image.row(y + 11) + (7 * 4), image.row(y + 11) + (37 * 4), region.row(y));
+    }
+
+    const ImageView view = image.crop(7, 11, 30, 20);
+    EXPECT_EQ(image.row(11) + (7 * 4), view.data);
+    EXPECT_EQ(93u * 4u, view.stride);
+
+    for (auto algo : g_allAlgorithms)
+    {
+        Image expected;
+        region.resizeInto(expected, 17, 45, algo);
+
+        Image result;
+        view.resizeInto(result, 17, 45, algo);
+        EXPECT_EQ(expected.data, result.data) << "Mismatch for algorithm " << static_cast<int>(algo);
+    }
+
+    EXPECT_EQ(ImageView(region).row(3)[5], view.crop(0, 1, 10, 10).row(2)[5]);
+    EXPECT_THROW(image.crop(64, 0, 30, 20), std::runtime_error);
+    EXPECT_THROW(view.crop(0, 1, 30, 20), std::runtime_error);
+    EXPECT_THROW(view.resizeInto(image, 17, 45, ResizeAlgorithm::Bilinear), std::runtime_error);
+}
+
+TEST_F(ImageResizeTest, sharedImageCopyOnWrite)
+{
+    auto image = createImage(31, 17, 3);
+    for (size_t i = 0; i < image.data.size(); ++i)
+    {
+        image.data[i] = static_cast<uint8_t>(i * 13);
+    }
+
+    const auto* pixels = image.data.data();
+    const auto original = image.clone();
+    EXPECT_NE(pixels, original.data.data());
+    EXPECT_EQ(image.data, original.data);
+
+    SharedImage shared(std::move(image));
+    EXPECT_EQ(pixels, shared->data.data());
+    EXPECT_FALSE(shared.isShared());
+
+    SharedImage copy = shared;
+    EXPECT_TRUE(copy.isShared());
+    EXPECT_EQ(pixels, copy.view().data);
+
+    // the copy gets its own pixels, the original stays untouched
+    copy.mutableImage()->data[0] = 255;
+    EXPECT_NE(pixels, copy->data.data());
+    EXPECT_FALSE(copy.isShared());
+    EXPECT_FALSE(shared.isShared());
+    EXPECT_EQ(original.data, shared->data);
+    EXPECT_EQ(255, copy->data[0]);
+
+    // no longer shared, no copy needed
+    shared.mutableImage()->data[1] = 7;
+    EXPECT_EQ(pixels, shared->data.data());
+
+    {
+        // a copy made while the image is being modified does not see the modifications
+        auto writer = shared.mutableImage();
+        SharedImage snapshot = shared;
+        EXPECT_FALSE(shared.isShared());
+        EXPECT_NE(pixels, snapshot->data.data());
+
+        writer->data[2] = 9;
+        EXPECT_EQ(9, shared->data[2]);
+        EXPECT_EQ(original.data[2], snapshot->data[2]);
+    }
+
+    {
+        // once the writer is gone copies share the pixels again
+        SharedImage snapshot = shared;
+        EXPECT_TRUE(shared.isShared());
+        EXPECT_EQ(pixels, snapshot->data.data());
+    }
+
+    Image result;
+    shared.view().resizeInto(result, 10, 5, ResizeAlgorithm::Bilinear);
+    EXPECT_EQ(10u, result.width);
+
+    // assigning and moving keep the reference count
+    SharedImage assigned;
+    assigned = shared;
+    EXPECT_TRUE(shared.isShared());
+    SharedImage moved(std::move(assigned));
+    EXPECT_FALSE(assigned);
+    EXPECT_TRUE(shared.isShared());
+    moved = SharedImage();
+    EXPECT_FALSE(shared.isShared());
+
+    auto released = shared.release();
+    EXPECT_EQ(pixels, released.data.data());
+    EXPECT_FALSE(shared);
+    EXPECT_EQ(0u, shared.release().width);
+}
+
+TEST_F(ImageResizeTest, tiledImageAllocatesTilesOnWrite)
+{
+    TiledImage tiled(150, 70, PixelFormat::RGB8, 64);
+    EXPECT_EQ(3u, tiled.columns());
+    EXPECT_EQ(2u, tiled.rows());
+    EXPECT_EQ(0u, tiled.residentTiles());
+
+    // unwritten tiles read as zero
+    EXPECT_EQ(22u, tiled.tile(2, 0).width);
+    EXPECT_EQ(6u, tiled.tile(2, 1).height);
+    EXPECT_EQ(0, tiled.tile(1, 1).row(5)[7]);
+    EXPECT_FALSE(tiled.isAllocated(1, 1));
+
+    const std::vector<uint8_t> row(150 * 3, 9);
+    tiled.writeRows(66, 1, row.data(), 0);
+    EXPECT_EQ(3u, tiled.residentTiles());
+    EXPECT_FALSE(tiled.isAllocated(0, 0));
+    EXPECT_TRUE(tiled.isAllocated(2, 1));
+    EXPECT_EQ(9, tiled.tile(2, 1).row(2)[65]);
+    EXPECT_EQ(0, tiled.tile(2, 1).row(3)[65]);
+
+    auto image = createImage(150, 70, 3);
+    for (size_t i = 0; i < image.data.size(); ++i)
+    {
+        image.data[i] = static_cast<uint8_t>((i * 7919) >> 3);
+    }
+
+    EXPECT_EQ(image.data, TiledImage::fromImage(image, 64).toImage().data);
+    EXPECT_THROW(tiled.tile(3, 0), std::runtime_error);
+}
+
+TEST_F(ImageResizeTest, tiledResizeMatchesImageResize)
+{
+    for (uint32_t planes : { 3u, 4u })
+    {
+        auto image = createImage(302, 204, planes);
+        for (size_t i = 0; i < image.data.size(); ++i)
+        {
+            image.data[i] = static_cast<uint8_t>((i * 7919) >> 3);
+        }
+
+        const auto tiled = TiledImage::fromImage(image, 32);
+
+        for (bool linearLight : { false, true })
+        {
+            ResizeOptions options;
+            options.threads = 3;
+            options.premultiplyAlpha = true;
+            options.linearLight = linearLight;
+
+            for (auto algo : g_allAlgorithms)
+            {
+                // the tiles are resized from a part of the source columns, including the exact 2x reduction
+                for (auto size : { std::make_pair(97u, 45u), std::make_pair(151u, 102u), std::make_pair(450u, 333u) })
+                {
+                    Image expected;
+                    image.resizeInto(expected, size.first, size.second, algo, options);
+
+                    TiledImage result;
+                    tiled.resizeInto(result, size.first, size.second, algo, options);
+                    EXPECT_EQ(32u, result.tileSize());
+                    EXPECT_EQ(expected.data, result.toImage().data) << "Mismatch for algorithm " << static_cast<int>(algo)
+                                                                    << " with " << planes << " planes, linear light " << linearLight;
+                }
+            }
+        }
+    }
+}
+
+TEST_F(ImageResizeTest, resizePlanRegionRequiresSourcePixels)
+{
+    const ResizePlan plan(100, 80, 30, 20, ResizeAlgorithm::Bicubic, 3);
+
+    const auto columns = plan.sourceColumns(10, 20);
+    const auto rows = plan.sourceRows(5, 15);
+    EXPECT_LT(0u, columns.first);
+    EXPECT_GT(100u, columns.second);
+
+    std::vector<uint8_t> region(((columns.second - columns.first) * 3 * (rows.second - rows.first)) + 16);
+    const ImageView source(region.data(), columns.second - columns.first, rows.second - rows.first, (columns.second - columns.first) * 3, PixelFormat::RGB8);
+
+    std::vector<uint8_t> result(10 * 10 * 3);
+    EXPECT_NO_THROW(plan.runRegion(source, columns.first, rows.first, 10, 5, 10, 10, result.data(), 30, ResizeOptions()));
+    EXPECT_THROW(plan.runRegion(source, columns.first + 1, rows.first, 10, 5, 10, 10, result.data(), 30, ResizeOptions()), std::runtime_error);
+    EXPECT_THROW(plan.runRegion(source, columns.first, rows.first, 10, 5, 11, 10, result.data(), 30, ResizeOptions()), std::runtime_error);
+}
+
+TEST_F(ImageResizeTest, tiledImageEvictsTiles)
+{
+    auto image = createImage(200, 100, 3);
+    for (size_t i = 0; i < image.data.size(); ++i)
+    {
+        image.data[i] = static_cast<uint8_t>((i * 7919) >> 3);
+    }
+
+    auto tiled = TiledImage::fromImage(image, 16);
+    EXPECT_EQ(13u * 7u, tiled.residentTiles());
+
+    tiled.setResidentTileLimit(5, ".");
+    EXPECT_EQ(5u, tiled.residentTiles());
+    EXPECT_EQ(image.data, tiled.toImage().data);
+    EXPECT_EQ(5u, tiled.residentTiles());
+
+    // modified tiles are written again when they are evicted
+    tiled.writableTile(0, 0).data[0] = 1;
+    tiled.readRows(50, 50, image.row(50), image.rowStride());
+    EXPECT_EQ(1, tiled.tile(0, 0).row(0)[0]);
+
+    Image expected;
+    image.data[0] = 1;
+    image.resizeInto(expected, 70, 30, ResizeAlgorithm::Lanczos3);
+
+    TiledImage result;
+    result.setResidentTileLimit(2, ".");
+    tiled.resizeInto(result, 70, 30, ResizeAlgorithm::Lanczos3);
+    EXPECT_EQ(2u, result.residentTiles());
+    EXPECT_EQ(expected.data, result.toImage().data);
+}
+
+TEST_F(ImageResizeTest, resizeAlignsRows)
+{
+    auto image = createImage(93, 41, 3);
+    for (size_t i = 0; i < image.data.size(); ++i)
+    {
+        image.data[i] = static_cast<uint8_t>((i * 7919) >> 3);
+    }
+
+    Image expected;
+    image.resizeInto(expected, 50, 20, ResizeAlgorithm::Bilinear);
+    EXPECT_EQ(150u, expected.rowStride());
+
+    setRowAlignment(PixelAlignment);
+    image.resize(50, 20, ResizeAlgorithm::Bilinear);
+    EXPECT_EQ(192u, image.stride);
+    EXPECT_EQ(192u * 20u, image.data.size());
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(image.row(1)) % PixelAlignment);
+
+    for (uint32_t y = 0; y < 20; ++y)
+    {
+        EXPECT_TRUE(std::equal(expected.row(y), expected.row(y) + 150, image.row(y))) << "Mismatch at row " << y;
+    }
+}
+
+TEST_F(ImageResizeTest, pyramidLevelDimensions)
+{
+    auto image = createImage(100, 37, 3);
+
+    const ImagePyramid pyramid(image);
+    ASSERT_EQ(7u, pyramid.levels());
+    EXPECT_EQ(50u, pyramid.width(0));
+    EXPECT_EQ(19u, pyramid.height(0));
+    EXPECT_EQ(13u, pyramid.width(2));
+    EXPECT_EQ(5u, pyramid.height(2));
+    EXPECT_EQ(1u, pyramid.width(6));
+    EXPECT_EQ(1u, pyramid.height(6));
+    EXPECT_EQ(pyramid.data(0) + (50 * 19 * 3), pyramid.data(1));
+
+    EXPECT_EQ(3u, ImagePyramid(image, 5).levels());
+    EXPECT_EQ(0u, ImagePyramid(image, 20).levels());
+    EXPECT_THROW(pyramid.width(7), std::runtime_error);
+}
+
+TEST_F(ImageResizeTest, pyramidAveragesOddEdges)
+{
+    auto image = createImage(3, 3, 1);
+    image.data = { 10, 20, 31,
+                   30, 40, 51,
+                   70, 80, 91 };
+
+    const ImagePyramid pyramid(image);
+    ASSERT_EQ(2u, pyramid.levels());
+    EXPECT_EQ(std::vector<uint8_t>({ 25, 41, 75, 91 }), pyramid.image(0).data);
+    EXPECT_EQ(std::vector<uint8_t>({ 58 }), pyramid.image(1).data);
+}
+
+TEST_F(ImageResizeTest, pyramidMatchesAreaReduction)
+{
+    for (uint32_t bitDepth : { 8, 16 })
+    {
+        for (uint32_t planes = 1; planes <= 4; ++planes)
+        {
+            auto image = createImage(96, 64, planes, bitDepth);
+            for (size_t i = 0; i < image.data.size(); ++i)
+            {
+                image.data[i] = static_cast<uint8_t>((i * 7919) >> 3);
+            }
+
+            for (auto level : { SimdLevel::None, SimdLevel::Sse41, SimdLevel::Avx2 })
+            {
+                setSimdLevel(level);
+
+                const ImagePyramid pyramid(image);
+                ASSERT_EQ(7u, pyramid.levels());
+
+                Image expected;
+                image.resizeInto(expected, 48, 32, ResizeAlgorithm::Area);
+                for (uint32_t i = 0; i < 5; ++i)
+                {
+                    EXPECT_EQ(expected.data, pyramid.image(i).data) << "Mismatch for " << planes << " planes, " << bitDepth << " bit, level " << i;
+
+                    Image next;
+                    expected.resizeInto(next, expected.width / 2, expected.height / 2, ResizeAlgorithm::Area);
+                    expected = std::move(next);
+                }
+            }
+        }
+    }
+}
+
+TEST_F(ImageResizeTest, bilinearSimdReduction)
+{
+    expectSimdMatchesScalar(fileops::readFile(g_jpegTestData), 181, 119);
+}
+
+TEST_F(ImageResizeTest, bilinearSimdZoom)
+{
+    expectSimdMatchesScalar(fileops::readFile(g_jpegSmallTestData), 743, 501);
+}
+
+TEST_F(ImageResizeTest, multiThreadedResizeIsIdentical)
+{
+    auto jpegData = fileops::readFile(g_jpegTestData);
+
+    ResizeOptions spawnThreads;
+    spawnThreads.threads = 4;
+
+    std::vector<std::thread> executorThreads;
+    ResizeOptions customExecutor;
+    customExecutor.threads = 3;
+    customExecutor.executor = [&] (std::function<void()> task) {
+        executorThreads.emplace_back(std::move(task));
+    };
+
+    for (auto algo : { ResizeAlgorithm::NearestNeighbor, ResizeAlgorithm::Bilinear, ResizeAlgorithm::Lanczos3, ResizeAlgorithm::Area })
+    {
+        auto reference = Factory::createFromData(jpegData);
+        reference->resize(451, 299, algo);
+
+        for (auto& options : { spawnThreads, customExecutor })
+        {
+            auto image = Factory::createFromData(jpegData);
+            image->resize(451, 299, algo, options);
+            EXPECT_EQ(reference->data, image->data);
+        }
+    }
+
+    for (auto& thread : executorThreads)
+    {
+        thread.join();
+    }
+}
+
+TEST_F(ImageResizeTest, multiThreadedResizeReportsExecutorErrors)
+{
+    auto image = createImage(300, 200, 3);
+
+    ResizeOptions options;
+    options.threads = 4;
+    options.executor = [] (std::function<void()>) {
+        throw std::runtime_error("Executor is shutting down");
+    };
+
+    EXPECT_THROW(image.resize(150, 100, ResizeAlgorithm::Bilinear, options), std::runtime_error);
+}
+
+TEST_F(ImageResizeTest, resizeIntoReusesDestinationImage)
+{
+    auto jpegData = fileops::readFile(g_jpegTestData);
+    auto image = Factory::createFromData(jpegData);
+
+    Image thumbnail;
+    thumbnail.data.reserve(200 * 150 * 3);
+    const uint8_t* buffer = thumbnail.data.data();
+
+    for (auto algo : { ResizeAlgorithm::NearestNeighbor, ResizeAlgorithm::Bilinear, ResizeAlgorithm::Mitchell })
+    {
+        image->resizeInto(thumbnail, 200, 150, algo);
+        EXPECT_EQ(buffer, thumbnail.data.data());
+        EXPECT_EQ(200u, thumbnail.width);
+        EXPECT_EQ(150u, thumbnail.height);
+        EXPECT_EQ(image->bitDepth, thumbnail.bitDepth);
+        EXPECT_EQ(image->colorPlanes, thumbnail.colorPlanes);
+
+        auto reference = Factory::createFromData(jpegData);
+        reference->resize(200, 150, algo);
+        EXPECT_EQ(reference->data, thumbnail.data);
+    }
+}
+
+TEST_F(ImageResizeTest, resizeIntoCallerOwnedMemoryHonorsStride)
+{
+    constexpr uint32_t width = 123;
+    constexpr uint32_t height = 77;
+    constexpr uint32_t stride = 384;
+    constexpr uint8_t padding = 0xAB;
+
+    auto jpegData = fileops::readFile(g_jpegTestData);
+    auto image = Factory::createFromData(jpegData);
+
+    auto reference = Factory::createFromData(jpegData);
+    reference->resize(width, height, ResizeAlgorithm::Bilinear);
+
+    std::vector<uint8_t> buffer(stride * height, padding);
+    image->resizeInto(buffer.data(), stride, width, height, ResizeAlgorithm::Bilinear);
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        auto row = buffer.begin() + (y * stride);
+        auto referenceRow = reference->data.begin() + (y * width * 3);
+        EXPECT_TRUE(std::equal(referenceRow, referenceRow + (width * 3), row));
+        EXPECT_TRUE(std::all_of(row + (width * 3), row + stride, [=] (uint8_t value) { return value == padding; }));
+    }
+
+    EXPECT_THROW(image->resizeInto(buffer.data(), (width * 3) - 1, width, height, ResizeAlgorithm::Bilinear), std::runtime_error);
+    EXPECT_THROW(image->resizeInto(*image, width, height, ResizeAlgorithm::Bilinear), std::runtime_error);
+}
+
+#if HAVE_PNG
+TEST_F(ImageResizeTest, resizeRgbaPng)
+{
+    auto image = Factory::createFromUri(g_rgbaPng);
+    ASSERT_EQ(4u, image->colorPlanes);
+
+    image->resize(100, 100, ResizeAlgorithm::Bilinear);
+    EXPECT_EQ(100u * 100u * 4u, image->data.size());
+
+    auto pngStore = Factory::createLoadStore(Type::Png);
+    pngStore->storeToFile(*image, "ResizedRGBA.png");
+}
+
+TEST_F(ImageResizeTest, store16BitPngKeepsNativeSamples)
+{
+    auto image = createImage(37, 21, 3, 16);
+    auto* samples = reinterpret_cast<uint16_t*>(image.data.data());
+    for (uint32_t i = 0; i < 37 * 21 * 3; ++i)
+    {
+        samples[i] = static_cast<uint16_t>(i * 97);
+    }
+
+    auto pngStore = Factory::createLoadStore(Type::Png);
+    auto loaded = pngStore->loadFromMemory(pngStore->storeToMemory(image));
+    EXPECT_EQ(16u, loaded->bitDepth);
+    EXPECT_EQ(image.data, loaded->data);
+
+    auto pngData = pngStore->storeToMemory(image);
+    auto reloaded = pngStore->loadFromMemory(pngData);
+    reloaded->resize(20, 10, ResizeAlgorithm::Lanczos3);
+    EXPECT_EQ(20u * 10u * 3u * 2u, reloaded->data.size());
+}
+
+TEST_F(ImageResizeTest, storeCroppedView)
+{
+    auto image = createImage(37, 21, 3);
+    for (size_t i = 0; i < image.data.size(); ++i)
+    {
+        image.data[i] = static_cast<uint8_t>(i * 13);
+    }
+
+    auto region = createImage(10, 5, 3);
+    for (uint32_t y = 0; y < 5; ++y)
+    {
+        std::copy(image.row(y + 3) + (4 * 3), image.row(y + 3) + (14 * 3), region.row(y));
+    }
+
+    auto pngStore = Factory::createLoadStore(Type::Png);
+    EXPECT_EQ(pngStore->storeToMemory(region), pngStore->storeToMemory(image.crop(4, 3, 10, 5)));
+}
+
+TEST_F(ImageResizeTest, pngHonorsRowAlignment)
+{
+    auto image = createImage(37, 21, 4);
+    for (size_t i = 0; i < image.data.size(); ++i)
+    {
+        image.data[i] = static_cast<uint8_t>(i * 13);
+    }
+
+    auto pngStore = Factory::createLoadStore(Type::Png);
+    auto pngData = pngStore->storeToMemory(image);
+
+    setRowAlignment(PixelAlignment);
+    auto aligned = pngStore->loadFromMemory(pngData);
+    EXPECT_EQ(192u, aligned->stride);
+    for (uint32_t y = 0; y < 21; ++y)
+    {
+        EXPECT_TRUE(std::equal(image.row(y), image.row(y) + (37 * 4), aligned->row(y))) << "Mismatch at row " << y;
+    }
+
+    // storing the padded rows produces the same file
+    EXPECT_EQ(pngData, pngStore->storeToMemory(*aligned));
+}
+#endif
+
+TEST_F(ImageResizeTest, setSimdLevelIsClampedToDetectedLevel)
+{
+    setSimdLevel(SimdLevel::Avx2);
+    EXPECT_EQ(detectSimdLevel(), simdLevel());
+
+    setSimdLevel(SimdLevel::None);
+    EXPECT_EQ(SimdLevel::None, simdLevel());
+}
+#endif
+
+}
+}